@@ -1,11 +1,5 @@
 #version 330 core
 
-struct vx_light
-{
-    vec3 position;
-    vec3 color;
-};
-
 struct vx_material
 {
     vec3 ambientColor;
@@ -19,14 +13,23 @@ out vec4 color;
 in vec3 frag_normal;
 in vec3 frag_position;
 
-uniform vec3 cameraPosition;
+// Written once per frame, see vx::FrameUniforms.
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec3 camera_position;
+    vec3 light_position;
+    vec3 light_color;
+};
+
 uniform vx_material material;
-uniform vx_light light;
 
 void main()
 {
     vec3 normal = normalize(frag_normal);
-    vec3 frag_to_light = normalize(light.position - frag_position);
+    vec3 frag_to_light = normalize(light_position - frag_position);
     // ===========================
     // ambient component
     // ===========================
@@ -38,12 +41,12 @@ void main()
     // ===========================
     // specular component
     // ===========================
-    vec3 frag_to_camera = normalize(cameraPosition - frag_position);
+    vec3 frag_to_camera = normalize(camera_position - frag_position);
     vec3 specularComponent = material.specularColor * pow(
         max(dot(reflect(-frag_to_light, normal), frag_to_camera), 0.0f),
         material.shininess
     );
 
-    color = vec4(light.color, 1.0f) *
+    color = vec4(light_color, 1.0f) *
         vec4(ambientComponent + diffuseComponent + specularComponent, 1.0f);
 }
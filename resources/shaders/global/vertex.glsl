@@ -1,21 +1,47 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+// Packed chunk vertex, see vx::ChunkVertex.
+layout (location = 0) in uint vertex;
 
 out vec3 frag_normal;
 out vec3 frag_position;
 
-// uniform mat4 projection = mat4(1.0f);
-// uniform mat4 view = mat4(1.0f);
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model = mat4(1.0f);
+// Written once per frame, see vx::FrameUniforms.
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec3 camera_position;
+    vec3 light_position;
+    vec3 light_color;
+};
+
+// World position of the block (0, 0, 0) of the chunk of every page of the vertex buffer, see
+// vx::ChunkManager::chunk_origins. gl_VertexID includes the base vertex of the draw.
+uniform samplerBuffer chunk_origins;
+
+const float BLOCK_SIZE = 1.0f;
+const int VERTEX_PAGE_SIZE = 256;
+
+// Indexed by vx::Face.
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3( 0.0f,  0.0f, -1.0f), // back
+    vec3( 0.0f,  0.0f,  1.0f), // front
+    vec3( 1.0f,  0.0f,  0.0f), // right
+    vec3(-1.0f,  0.0f,  0.0f), // left
+    vec3( 0.0f,  1.0f,  0.0f), // up
+    vec3( 0.0f, -1.0f,  0.0f)  // down
+);
 
 void main()
 {
-    frag_position = vec3(model * vec4(position, 1.0f));
-    frag_normal = mat3(transpose(inverse(model))) * normal;
+    vec3 local = vec3(vertex & 63u, (vertex >> 6) & 63u, (vertex >> 12) & 63u);
+    uint face = (vertex >> 18) & 7u;
+    vec3 chunk_origin = texelFetch(chunk_origins, gl_VertexID / VERTEX_PAGE_SIZE).xyz;
+
+    frag_position = chunk_origin + local * BLOCK_SIZE;
+    frag_normal = FACE_NORMALS[face];
 
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+    gl_Position = view_projection * vec4(frag_position, 1.0f);
 }
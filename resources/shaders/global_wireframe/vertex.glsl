@@ -1,13 +1,29 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+// Packed chunk vertex, see vx::ChunkVertex.
+layout (location = 0) in uint vertex;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model = mat4(1.0f);
+// Written once per frame, see vx::FrameUniforms.
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec3 camera_position;
+    vec3 light_position;
+    vec3 light_color;
+};
+
+// World position of the block (0, 0, 0) of the chunk of every page of the vertex buffer, see
+// vx::ChunkManager::chunk_origins. gl_VertexID includes the base vertex of the draw.
+uniform samplerBuffer chunk_origins;
+
+const float BLOCK_SIZE = 1.0f;
+const int VERTEX_PAGE_SIZE = 256;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0f);
+    vec3 local = vec3(vertex & 63u, (vertex >> 6) & 63u, (vertex >> 12) & 63u);
+    vec3 chunk_origin = texelFetch(chunk_origins, gl_VertexID / VERTEX_PAGE_SIZE).xyz;
+    gl_Position = view_projection * vec4(chunk_origin + local * BLOCK_SIZE, 1.0f);
 }
@@ -0,0 +1,20 @@
+#version 330 core
+
+// World position of an occluder corner, see render_chunk_occluders.
+layout (location = 0) in vec3 position;
+
+// Written once per frame, see vx::FrameUniforms.
+layout (std140) uniform FrameUniforms
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec3 camera_position;
+    vec3 light_position;
+    vec3 light_color;
+};
+
+void main()
+{
+    gl_Position = view_projection * vec4(position, 1.0f);
+}
@@ -17,15 +17,14 @@
 #include "vx_ui_manager.hpp"
 #include "vx_log_manager.hpp"
 #include "vx_chunk_manager.hpp"
+#include "vx_stream_buffer.hpp"
 #include "vx_debug_counters.hpp"
 #include "vx_depth_buffer_rasterizer.hpp"
 #include "vx.hpp"
-#include "glm/gtc/type_ptr.hpp"
 
 void key_callback(GLFWwindow* window, i32 key, i32 scancode, i32 action, i32 mode);
 GLFWwindow* create_glfw_window_and_context(const char* title, u32 width, u32 height);
 void initialize_glew();
-void setup_projection_matrix(GLuint program, const glm::mat4& projection);
 
 u64 g_debugCounters[DebugCycleCount_Count] = {0};
 
@@ -76,33 +75,30 @@ main(void)
     vx::Camera camera(CAMERA_POSITION, FOVY, YAW, PITCH, WORLD_UP,
                       SCREEN_RATIO, CAMERA_MOVE_SPEED, CAMERA_TURN_SPEED);
 
+    // -------------------------
+    // Per frame data, 4 MB
+    // -------------------------
+    auto* stream_buffer = new vx::StreamBuffer(4 << 20);
     // -------------------------
     // Shaders
     // -------------------------
-    auto* shader_manager = new vx::ShaderManager();
+    auto* shader_manager = new vx::ShaderManager(stream_buffer);
 
     vx::Shader* global_shader = shader_manager->load_program("global");
     global_shader->load_uniform_location("material.ambientColor");
     global_shader->load_uniform_location("material.diffuseColor");
     global_shader->load_uniform_location("material.specularColor");
     global_shader->load_uniform_location("material.shininess");
-    global_shader->load_uniform_location("cameraPosition");
-    global_shader->load_uniform_location("light.position");
-    global_shader->load_uniform_location("light.color");
-    global_shader->load_uniform_location("model");
-    global_shader->load_uniform_location("view");
-    global_shader->load_uniform_location("projection");
-    setup_projection_matrix(global_shader->program, camera.frustum.projection);
+    global_shader->load_uniform_location("chunk_origins");
 
     vx::Shader* global_wireframe_shader = shader_manager->load_program("global_wireframe");
     global_wireframe_shader->load_uniform_location("material.ambientColor");
     global_wireframe_shader->load_uniform_location("material.diffuseColor");
     global_wireframe_shader->load_uniform_location("material.specularColor");
     global_wireframe_shader->load_uniform_location("material.shininess");
-    global_wireframe_shader->load_uniform_location("model");
-    global_wireframe_shader->load_uniform_location("view");
-    global_wireframe_shader->load_uniform_location("projection");
-    setup_projection_matrix(global_wireframe_shader->program, camera.frustum.projection);
+    global_wireframe_shader->load_uniform_location("chunk_origins");
+
+    shader_manager->load_program("occluders");
 
     vx::Shader* font_shader = shader_manager->load_program("font_render");
     font_shader->load_uniform_location("textColor");
@@ -117,7 +113,7 @@ main(void)
     // -------------------------
     // User Interface (TODO: Improve this)
     // -------------------------
-    auto* ui_manager = new vx::UIManager("Monoid", font_shader, &display);
+    auto* ui_manager = new vx::UIManager("Monoid", font_shader, &display, stream_buffer);
     // -------------------------
     // Log
     // -------------------------
@@ -125,14 +121,15 @@ main(void)
     // -------------------------
     // Chunks
     // -------------------------
-    auto* chunk_manager = new vx::ChunkManager();
-    // for (i32 x = 0; x < vx::WORLD_SIZE; x++)
-    //     for (i32 y = 0; y < vx::WORLD_SIZE-5; y++)
-    //         for (i32 z = 0; z < vx::WORLD_SIZE; z++)
+    auto* chunk_manager = new vx::ChunkManager(stream_buffer);
+    // for (i32 x = -4; x < 4; x++)
+    //     for (i32 y = -4; y < -1; y++)
+    //         for (i32 z = -4; z < 4; z++)
     //         {
-    //             chunk_manager->create_chunk(x, y, z, global_shader, material);
+    //             chunk_manager->request_chunk(x, y, z, global_shader, chunk_material);
     //         }
-    chunk_manager->create_chunk(0, 0, 0, global_shader, material);
+    u32 chunk_material = chunk_manager->add_material(material);
+    chunk_manager->request_chunk(0, 0, 0, global_shader, chunk_material);
     /* vx_chunk_manager_CreateChunk(chunkManager, 1, 0, 0, globalShader, material); */
     /* vx_chunk_manager_CreateChunk(chunkManager, 2, 0, 0, globalShader, material); */
     /* vx_chunk_manager_CreateChunk(chunkManager, 0, 1, 0, globalShader, material); */
@@ -147,6 +144,7 @@ main(void)
     memory.ui_manager = ui_manager;
     memory.log_manager = log_manager;
     memory.chunk_manager = chunk_manager;
+    memory.stream_buffer = stream_buffer;
     memory.depth_buf = new vx::DepthBufferRasterizer(display.width, display.height);
     memory.depth_buf->set_projection_matrix(camera.frustum.projection);
 
@@ -155,6 +153,8 @@ main(void)
     constexpr f64 DESIRED_FRAMETIME = 1.0 / DESIRED_FPS;
     constexpr u32 MAX_STEPS = 6;
     constexpr f64 MAX_DELTA_TIME = 1.0;
+    // Chunks built by the builder threads that are uploaded each frame at most.
+    constexpr u32 MAX_CHUNK_UPLOADS = 8;
 
     f64 new_time, total_delta, delta, frame_time;
     f64 previous_time = glfwGetTime();
@@ -198,6 +198,8 @@ main(void)
         // Main render function is called here
         // ===========================================================
         // BEGIN_TIMED_BLOCK(DebugCycleCount_MainRender);
+        chunk_manager->upload_built_chunks(MAX_CHUNK_UPLOADS);
+        chunk_manager->update_dirty_meshes();
         vx::main_render(memory, camera, keyboard);
         // END_TIMED_BLOCK(DebugCycleCount_MainRender);
 
@@ -252,11 +254,3 @@ initialize_glew()
         abort();
     }
 }
-
-void
-setup_projection_matrix(GLuint program, const glm::mat4& projection)
-{
-    glUseProgram(program);
-    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUseProgram(0);
-}
@@ -98,6 +98,80 @@ max3(i32 a, i32 b, i32 c)
     return r;
 }
 
+// --------------------
+//    Bit operations
+// --------------------
+inline u32
+popcount(u32 bits)
+{
+    return __builtin_popcount(bits);
+}
+
+inline u32
+popcount(u64 bits)
+{
+    return __builtin_popcountll(bits);
+}
+
+// NOTE: Undefined for 0, the caller has to check it first.
+inline u32
+count_trailing_zeros(u32 bits)
+{
+    ASSERT(bits != 0);
+    return __builtin_ctz(bits);
+}
+
+inline u32
+count_trailing_zeros(u64 bits)
+{
+    ASSERT(bits != 0);
+    return __builtin_ctzll(bits);
+}
+
+// NOTE: Undefined for 0, the caller has to check it first.
+inline u32
+count_leading_zeros(u32 bits)
+{
+    ASSERT(bits != 0);
+    return __builtin_clz(bits);
+}
+
+// --------------------
+//    Atomics
+// --------------------
+// Return the new value.
+inline u32
+atomic_increment(u32* value)
+{
+    return __atomic_add_fetch(value, 1, __ATOMIC_RELAXED);
+}
+
+inline u32
+atomic_decrement(u32* value)
+{
+    return __atomic_sub_fetch(value, 1, __ATOMIC_ACQ_REL);
+}
+
+inline u32
+atomic_load(const u32* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+inline void
+atomic_store(u32* value, u32 new_value)
+{
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+// Sets value to desired if it still holds expected. Otherwise expected gets the current value.
+// May fail spuriously, so it is meant to be called in a loop.
+inline bool
+atomic_compare_exchange(u32* value, u32* expected, u32 desired)
+{
+    return __atomic_compare_exchange_n(value, expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
 }
 
 #endif // UM_HPP
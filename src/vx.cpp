@@ -74,25 +74,37 @@ vx::main_render(vx::Memory& mem, vx::Camera& camera, bool* keyboard)
 
     // std::cout << glm::to_string(view) << std::endl;
 
+    // Read by every program through the FrameUniforms block.
+    vx::FrameUniforms frame;
+    frame.view = view;
+    frame.projection = camera.frustum.projection;
+    frame.view_projection = camera.frustum.projection * view;
+    frame.camera_position = glm::vec4(camera.frustum.position, 1.0f);
+    frame.light_position = glm::vec4(50.0f, 100.0f, 50.0f, 1.0f);
+    frame.light_color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f); // white color
+    mem.shader_manager->update_frame_uniforms(frame);
+
     if (keyboard[GLFW_KEY_T] == GLFW_PRESS)
     {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         auto* wireframe_shader = mem.shader_manager->load_program("global_wireframe");
-        mem.chunk_manager->render_chunks_wireframe(view, wireframe_shader);
+        mem.chunk_manager->render_chunks_wireframe(wireframe_shader);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
     else if (keyboard[GLFW_KEY_R] == GLFW_PRESS)
     {
+        auto* occluders_shader = mem.shader_manager->load_program("occluders");
         glDisable(GL_CULL_FACE);
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        mem.chunk_manager->render_occluders(camera, mem, keyboard);
+        mem.chunk_manager->render_occluders(camera, occluders_shader, *mem.stream_buffer);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         glEnable(GL_CULL_FACE);
     }
     else if (keyboard[GLFW_KEY_Q] == GLFW_PRESS)
     {
+        auto* occluders_shader = mem.shader_manager->load_program("occluders");
         glDisable(GL_CULL_FACE);
-        mem.chunk_manager->render_occluders(camera, mem, keyboard);
+        mem.chunk_manager->render_occluders(camera, occluders_shader, *mem.stream_buffer);
         glEnable(GL_CULL_FACE);
     }
     else
@@ -100,15 +112,11 @@ vx::main_render(vx::Memory& mem, vx::Camera& camera, bool* keyboard)
         mem.depth_buf->set_view_matrix(view);
         mem.depth_buf->clear_buffer();
 
-        for (i32 z = 0; z < vx::WORLD_SIZE; z++)
-            for (i32 y = 0; y < vx::WORLD_SIZE; y++)
-                for (i32 x = 0; x < vx::WORLD_SIZE; x++)
-                {
-                    vx::Chunk& chunk = mem.chunk_manager->chunks[x][y][z];
-                    if (chunk.num_blocks == 0) continue;
-                    mem.depth_buf->draw_occluders(camera.frustum, chunk.occluders);
-                }
-        mem.chunk_manager->render_chunks(camera.frustum, view, mem, keyboard);
+        for (u32 i = 0; i < mem.chunk_manager->num_chunks; i++)
+        {
+            mem.depth_buf->draw_occluders(camera.frustum, mem.chunk_manager->occluders[i]);
+        }
+        mem.chunk_manager->render_chunks(camera.frustum, mem, keyboard);
     }
 
     // @Cleanup, TODO: Optimize this, TODO: Abstract the ui into something more pleasant
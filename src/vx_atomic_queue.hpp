@@ -0,0 +1,114 @@
+#ifndef VX_ATOMIC_QUEUE_HPP
+#define VX_ATOMIC_QUEUE_HPP
+
+#include <stdlib.h>
+#include "um.hpp"
+
+namespace vx
+{
+
+// Bounded queue that any number of threads can push to and pop from without locks, after
+// Dmitry Vyukov's bounded MPMC queue. Every cell has a sequence number telling whether it is
+// ready to be written or read on the current lap around the ring, so a thread only has to
+// win the compare exchange on the position and never waits for another one.
+//
+// Only meant for small trivially copyable values, e.g. pointers to jobs.
+template<typename T>
+struct AtomicQueue
+{
+    struct Cell
+    {
+        u32              sequence;
+        T                value;
+    };
+
+    Cell*                cells;
+    u32                  mask;
+    // Padded so the producers and the consumers do not share a cache line. Padding instead of
+    // alignas, since new does not honour over aligned types before C++17.
+    u8                   _pad0[64];
+    u32                  push_pos;
+    u8                   _pad1[64];
+    u32                  pop_pos;
+    u8                   _pad2[64];
+
+    // The capacity has to be a power of two.
+    explicit AtomicQueue(u32 capacity)
+        : mask(capacity - 1)
+        , push_pos(0)
+        , pop_pos(0)
+    {
+        ASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        this->cells = (Cell*)malloc(sizeof(Cell) * capacity);
+        ASSERT(this->cells != NULL);
+        for (u32 i = 0; i < capacity; i++)
+            this->cells[i].sequence = i;
+    }
+
+    ~AtomicQueue()
+    {
+        free(this->cells);
+    }
+
+    // Returns false if the queue is full.
+    bool push(T value)
+    {
+        u32 pos = um::atomic_load(&this->push_pos);
+        Cell* cell;
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const i32 diff = (i32)(um::atomic_load(&cell->sequence) - pos);
+            if (diff == 0)
+            {
+                if (um::atomic_compare_exchange(&this->push_pos, &pos, pos + 1))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // The cell still holds the value of the previous lap.
+                return false;
+            }
+            else
+            {
+                pos = um::atomic_load(&this->push_pos);
+            }
+        }
+        cell->value = value;
+        um::atomic_store(&cell->sequence, pos + 1);
+        return true;
+    }
+
+    // Returns false if the queue is empty.
+    bool pop(T& value)
+    {
+        u32 pos = um::atomic_load(&this->pop_pos);
+        Cell* cell;
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const i32 diff = (i32)(um::atomic_load(&cell->sequence) - (pos + 1));
+            if (diff == 0)
+            {
+                if (um::atomic_compare_exchange(&this->pop_pos, &pos, pos + 1))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = um::atomic_load(&this->pop_pos);
+            }
+        }
+        value = cell->value;
+        // Ready to be written on the next lap.
+        um::atomic_store(&cell->sequence, pos + this->mask + 1);
+        return true;
+    }
+};
+
+}
+
+#endif // VX_ATOMIC_QUEUE_HPP
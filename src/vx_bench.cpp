@@ -0,0 +1,434 @@
+// Micro benchmarks for the chunk code. Built and run with `make bench`, it does not open a
+// window or touch OpenGL, only the CPU side of the engine is measured. `make bench-baseline`
+// measures the mesher of the first commit on the same scenes, see vx_bench_baseline.cpp.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "glm/glm.hpp"
+#include "um.hpp"
+#include "open-simplex-noise.h"
+#include "vx_chunk_manager.hpp"
+#include "vx_voxel_layout.hpp"
+#include "vx_voxel_dag.hpp"
+#include "vx_bench_scenes.hpp"
+
+static_assert(SCENE_SIZE == vx::CHUNK_SIZE, "The scenes are single chunks");
+
+// Keeps the compiler from throwing away the results of the benchmarks.
+static volatile u64 g_sink;
+
+// The scenes are single chunks with nothing around them.
+static const vx::ChunkBorders NO_BORDERS = {};
+
+// Walks the voxels crossed by a ray starting inside the chunk, until it hits a block or leaves
+// the chunk. Returns the number of voxels visited.
+template<typename Layout>
+u32
+raycast(const u64* words, glm::vec3 origin, glm::vec3 dir)
+{
+    glm::ivec3 p = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step;
+    glm::vec3 t_max, t_delta;
+    for (i32 i = 0; i < 3; i++)
+    {
+        step[i] = dir[i] > 0 ? 1 : -1;
+        t_delta[i] = dir[i] != 0 ? fabsf(1.0f / dir[i]) : INFINITY;
+        f32 boundary = dir[i] > 0 ? (p[i] + 1) - origin[i] : origin[i] - p[i];
+        t_max[i] = dir[i] != 0 ? boundary * t_delta[i] : INFINITY;
+    }
+
+    u32 visited = 0;
+    while (p.x >= 0 && p.x < vx::CHUNK_SIZE &&
+           p.y >= 0 && p.y < vx::CHUNK_SIZE &&
+           p.z >= 0 && p.z < vx::CHUNK_SIZE)
+    {
+        visited++;
+        if (vx::voxel_get<Layout>(words, p.x, p.y, p.z))
+            break;
+
+        i32 axis = (t_max.x < t_max.y) ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+        p[axis] += step[axis];
+        t_max[axis] += t_delta[axis];
+    }
+    return visited;
+}
+
+template<typename Layout>
+void
+bench_layout(const Scene& scene, vx::ChunkMesh& mesh)
+{
+    static constexpr u32 ITERATIONS = 200;
+    static constexpr u32 NUM_RAYS = 100000;
+    static constexpr u32 NUM_LOOKUPS = 1000000;
+
+    u64 words[vx::VOXEL_LAYOUT_WORDS];
+    Layout::store_columns(words, scene.columns);
+
+    Columns columns;
+    Layout::load_columns(words, columns);
+    ASSERT(memcmp(columns, scene.columns, sizeof(Columns)) == 0);
+
+    // Getting the columns out of the layout, which is what every mesh rebuild starts with.
+    f64 extract_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            Layout::load_columns(words, columns);
+            g_sink += columns[i % 32][(i * 7) % 32];
+        }
+        extract_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    f64 mesh_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            Layout::load_columns(words, columns);
+            vx::build_chunk_mesh(columns, NO_BORDERS, mesh);
+            g_sink += mesh.num_vertices;
+        }
+        mesh_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    f64 occluders_ns;
+    {
+        Timer timer;
+        vx::ChunkOccluders occluders;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            Layout::load_columns(words, columns);
+            vx::build_chunk_occluders(columns, glm::vec3(0.0f), occluders);
+            g_sink += occluders.mask;
+        }
+        occluders_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    // Random single block reads, e.g. gameplay code asking what is at a position.
+    f64 lookup_ns;
+    {
+        srand(42);
+        static u16 positions[NUM_LOOKUPS];
+        for (u32 i = 0; i < NUM_LOOKUPS; i++)
+            positions[i] = rand() & 0x7FFF;
+
+        Timer timer;
+        u64 found = 0;
+        for (u32 i = 0; i < NUM_LOOKUPS; i++)
+        {
+            const u32 p = positions[i];
+            found += vx::voxel_get<Layout>(words, p >> 10, (p >> 5) & 31, p & 31);
+        }
+        g_sink += found;
+        lookup_ns = timer.elapsed_ns() / NUM_LOOKUPS;
+    }
+
+    f64 raycast_ns;
+    {
+        srand(42);
+        static glm::vec3 origins[NUM_RAYS];
+        static glm::vec3 dirs[NUM_RAYS];
+        for (u32 i = 0; i < NUM_RAYS; i++)
+        {
+            origins[i] = glm::vec3(rand() % 3200, rand() % 3200, rand() % 3200) / 100.0f;
+            dirs[i] = glm::normalize(glm::vec3(rand() % 200 - 100, rand() % 200 - 100, rand() % 200 - 100) + 0.5f);
+        }
+
+        Timer timer;
+        u64 visited = 0;
+        for (u32 i = 0; i < NUM_RAYS; i++)
+            visited += raycast<Layout>(words, origins[i], dirs[i]);
+        g_sink += visited;
+        raycast_ns = timer.elapsed_ns() / NUM_RAYS;
+    }
+
+    printf("%-8s %-8s %10.0f %10.0f %10.0f %10.2f %10.1f\n",
+           scene.name, Layout::NAME, extract_ns, mesh_ns, occluders_ns, lookup_ns, raycast_ns);
+}
+
+// Time of vx::build_chunk_mesh on columns that are already extracted, with the same columns
+// as the baseline benchmark.
+void
+bench_mesher(const Scene& scene, vx::ChunkMesh& mesh)
+{
+    static constexpr u32 ITERATIONS = 200;
+
+    vx::build_chunk_mesh(scene.columns, NO_BORDERS, mesh);
+    const u32 num_faces = mesh.num_faces[vx::MESH_INNER] + mesh.num_faces[vx::MESH_BORDER];
+
+    f64 mesh_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            vx::build_chunk_mesh(scene.columns, NO_BORDERS, mesh);
+            g_sink += mesh.num_vertices;
+        }
+        mesh_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    // 4 packed vertices per quad.
+    printf("%-8s %10u %10u %10u %10.0f\n", scene.name, num_faces, mesh.num_vertices / 4,
+           (u32)(mesh.num_vertices * sizeof(vx::ChunkVertex)), mesh_ns);
+}
+
+// A single block flipped in the middle of the chunk, remeshed whole and then only the slices
+// it touched. The update includes copying the rest of the mesh.
+void
+bench_edits(const Scene& scene, vx::ChunkMesh& mesh, vx::ChunkMesh& updated)
+{
+    static constexpr u32 ITERATIONS = 200;
+
+    Columns columns;
+    memcpy(columns, scene.columns, sizeof(Columns));
+    vx::build_chunk_mesh(columns, NO_BORDERS, mesh);
+    columns[16][16] ^= 1u << 16;
+    vx::ChunkDirtySlices dirty = {};
+    vx::mark_dirty_block(dirty, 16, 16, 16);
+
+    f64 full_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            vx::build_chunk_mesh(columns, NO_BORDERS, updated);
+            g_sink += updated.num_vertices;
+        }
+        full_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    f64 update_ns;
+    {
+        u32 changed_end;
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+            g_sink += vx::update_chunk_mesh(columns, NO_BORDERS, dirty, mesh, updated, changed_end);
+        update_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    printf("%-8s %10.0f %10.0f %9.2fx\n", scene.name, full_ns, update_ns, full_ns / update_ns);
+}
+
+// Quads and time of the fast and the minimal merge on the same columns.
+void
+bench_merge_modes(const Scene& scene, vx::ChunkMesh& mesh)
+{
+    static constexpr u32 ITERATIONS = 50;
+
+    u32 quads[2];
+    f64 ns[2];
+    const vx::ChunkMeshMode modes[2] = {vx::MESH_FAST, vx::MESH_MINIMAL};
+    for (u32 m = 0; m < 2; m++)
+    {
+        vx::build_chunk_mesh(scene.columns, NO_BORDERS, mesh, modes[m]);
+        quads[m] = mesh.num_vertices / 4;
+
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            vx::build_chunk_mesh(scene.columns, NO_BORDERS, mesh, modes[m]);
+            g_sink += mesh.num_vertices;
+        }
+        ns[m] = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    printf("%-8s %10u %10u %9.1f%% %10.0f %10.0f %9.2fx\n", scene.name, quads[0], quads[1],
+           100.0 * ((f64)quads[1] - quads[0]) / quads[0], ns[0], ns[1], ns[1] / ns[0]);
+}
+
+// The scenes again, over a region of chunks instead of a single one, for the dag. The chunks
+// are generated up front, so building the dag does not include the noise.
+struct DagWorld
+{
+    static constexpr u32 SIZE_LOG2 = 2;
+    static constexpr u32 SIZE = 1 << SIZE_LOG2;
+    static constexpr u32 NUM_CHUNKS = SIZE * SIZE * SIZE;
+
+    const char* name;
+    // Indexed [x][y][z] in chunks.
+    Columns     chunks[SIZE][SIZE][SIZE];
+
+    void set_block(u32 x, u32 y, u32 z)
+    {
+        chunks[x / vx::CHUNK_SIZE][y / vx::CHUNK_SIZE][z / vx::CHUNK_SIZE][x % vx::CHUNK_SIZE][z % vx::CHUNK_SIZE]
+            |= 1u << (y % vx::CHUNK_SIZE);
+    }
+};
+
+void
+generate_dag_worlds(DagWorld* worlds)
+{
+    static constexpr u32 WORLD_BLOCKS = DagWorld::SIZE * vx::CHUNK_SIZE;
+
+    struct osn_context* ctx;
+    int noise_result = open_simplex_noise(1234, &ctx);
+    ASSERT(noise_result == 0);
+
+    // Rolling hills through the middle of the region, solid chunks below and empty above.
+    worlds[0].name = "terrain";
+    memset(worlds[0].chunks, 0, sizeof(worlds[0].chunks));
+    for (u32 x = 0; x < WORLD_BLOCKS; x++)
+        for (u32 z = 0; z < WORLD_BLOCKS; z++)
+        {
+            f64 noise = open_simplex_noise2(ctx, x * 0.02, z * 0.02);
+            i32 height = WORLD_BLOCKS / 2 + (i32)(noise * 40.0);
+            for (i32 y = 0; y < height; y++)
+                worlds[0].set_block(x, y, z);
+        }
+
+    // Caves everywhere, blocks are kept where the 3D noise is positive.
+    worlds[1].name = "caves";
+    memset(worlds[1].chunks, 0, sizeof(worlds[1].chunks));
+    for (u32 x = 0; x < WORLD_BLOCKS; x++)
+        for (u32 z = 0; z < WORLD_BLOCKS; z++)
+            for (u32 y = 0; y < WORLD_BLOCKS; y++)
+                if (open_simplex_noise3(ctx, x * 0.1, y * 0.1, z * 0.1) > -0.1)
+                    worlds[1].set_block(x, y, z);
+
+    // Noise, nothing to share.
+    worlds[2].name = "random";
+    srand(1234);
+    Columns* chunks = &worlds[2].chunks[0][0][0];
+    for (u32 c = 0; c < DagWorld::NUM_CHUNKS; c++)
+        for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+            for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+                chunks[c][x][z] = ((u32)rand() << 16) ^ (u32)rand();
+
+    open_simplex_noise_free(ctx);
+}
+
+bool
+dag_world_chunk(vx::ChunkCoord coord, u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], void* user_data)
+{
+    const DagWorld& world = *(const DagWorld*)user_data;
+    memcpy(columns, world.chunks[coord.x][coord.y][coord.z], sizeof(Columns));
+    for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+            if (columns[x][z] != 0) return true;
+    return false;
+}
+
+// Builds the dag of the world and checks every chunk and a sample of blocks against the
+// source. The dense size is the occupancy of every chunk as columns, one bit per block.
+void
+bench_dag(const DagWorld& world)
+{
+    static constexpr u32 ITERATIONS = 10;
+    static constexpr u32 LOOKUPS = 1 << 20;
+    static constexpr u32 WORLD_BLOCKS = DagWorld::SIZE * vx::CHUNK_SIZE;
+
+    vx::VoxelDag dag;
+    f64 build_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+            dag.build(vx::ChunkCoord(0, 0, 0), DagWorld::SIZE_LOG2, dag_world_chunk, (void*)&world);
+        build_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    u32 mismatches = 0;
+    f64 extract_ns = 0.0;
+    for (u32 x = 0; x < DagWorld::SIZE; x++)
+        for (u32 y = 0; y < DagWorld::SIZE; y++)
+            for (u32 z = 0; z < DagWorld::SIZE; z++)
+            {
+                Columns source;
+                Columns columns;
+                const bool has_blocks = dag_world_chunk(vx::ChunkCoord(x, y, z), source, (void*)&world);
+                Timer timer;
+                const bool found = dag.get_chunk_columns(vx::ChunkCoord(x, y, z), columns);
+                extract_ns += timer.elapsed_ns();
+                if (found != has_blocks || memcmp(columns, source, sizeof(Columns)) != 0)
+                    mismatches++;
+            }
+    extract_ns /= DagWorld::NUM_CHUNKS;
+
+    // The same random blocks for the lookups of every world.
+    srand(4321);
+    u32 lookup_mismatches = 0;
+    f64 lookup_ns;
+    {
+        u32 (*positions)[3] = (u32(*)[3])malloc(sizeof(u32) * 3 * LOOKUPS);
+        ASSERT(positions != NULL);
+        for (u32 i = 0; i < LOOKUPS; i++)
+            for (u32 axis = 0; axis < 3; axis++)
+                positions[i][axis] = (u32)rand() % WORLD_BLOCKS;
+
+        u64 found = 0;
+        Timer timer;
+        for (u32 i = 0; i < LOOKUPS; i++)
+            found += dag.block(positions[i][0], positions[i][1], positions[i][2]);
+        lookup_ns = timer.elapsed_ns() / LOOKUPS;
+        g_sink += found;
+
+        for (u32 i = 0; i < LOOKUPS; i++)
+        {
+            const u32 x = positions[i][0], y = positions[i][1], z = positions[i][2];
+            const u32 column = world.chunks[x / vx::CHUNK_SIZE][y / vx::CHUNK_SIZE][z / vx::CHUNK_SIZE]
+                                           [x % vx::CHUNK_SIZE][z % vx::CHUNK_SIZE];
+            if (dag.block(x, y, z) != (((column >> (y % vx::CHUNK_SIZE)) & 1) != 0))
+                lookup_mismatches++;
+        }
+        free(positions);
+    }
+
+    const u32 dense_bytes = DagWorld::NUM_CHUNKS * sizeof(Columns);
+    const u32 dag_bytes = dag.memory_usage();
+    printf("%-8s %10u %10u %9.1f%% %8u %8u %10.0f %10.0f %10.1f %10u\n", world.name, dense_bytes,
+           dag_bytes, 100.0 * dag_bytes / dense_bytes, dag.num_nodes, dag.num_leaves, build_ns / 1000.0,
+           extract_ns, lookup_ns, mismatches + lookup_mismatches);
+}
+
+int
+main()
+{
+    static Scene scenes[NUM_SCENES];
+    generate_scenes(scenes);
+
+    // Both grow on the first meshes and are reused by the others, like the thread scratch meshes.
+    vx::ChunkMesh mesh = {};
+    vx::ChunkMesh updated = {};
+
+    printf("Voxel layouts, time per chunk (extract, mesh, occluders) or per query (lookup, ray), in ns.\n");
+    printf("Mesh and occluders include the column extraction.\n\n");
+    printf("%-8s %-8s %10s %10s %10s %10s %10s\n", "scene", "layout", "extract", "mesh", "occluders", "lookup", "ray");
+    for (u32 i = 0; i < COUNT_OF(scenes); i++)
+    {
+        bench_layout<vx::LinearLayout>(scenes[i], mesh);
+        bench_layout<vx::MortonLayout>(scenes[i], mesh);
+        bench_layout<vx::BrickLayout>(scenes[i], mesh);
+    }
+
+    printf("\nMesher, time per chunk in ns, on columns that are already extracted.\n\n");
+    printf("%-8s %10s %10s %10s %10s\n", "scene", "faces", "quads", "bytes", "mesh");
+    for (u32 i = 0; i < COUNT_OF(scenes); i++)
+        bench_mesher(scenes[i], mesh);
+
+    printf("\nEdits, time to remesh a chunk after one block changed, in ns.\n\n");
+    printf("%-8s %10s %10s %10s\n", "scene", "full", "slices", "speedup");
+    for (u32 i = 0; i < COUNT_OF(scenes); i++)
+        bench_edits(scenes[i], mesh, updated);
+
+    printf("\nMerge modes, quads and time per chunk in ns.\n\n");
+    printf("%-8s %10s %10s %10s %10s %10s %10s\n",
+           "scene", "fast", "minimal", "quads", "fast", "minimal", "slowdown");
+    for (u32 i = 0; i < COUNT_OF(scenes); i++)
+        bench_merge_modes(scenes[i], mesh);
+
+    static DagWorld worlds[3];
+    generate_dag_worlds(worlds);
+    printf("\nVoxel dag of %u^3 chunks, sizes in bytes, build time in us, extract per chunk and lookup in ns.\n",
+           DagWorld::SIZE);
+    printf("Mismatches are chunks and blocks that differ from the source.\n\n");
+    printf("%-8s %10s %10s %10s %8s %8s %10s %10s %10s %10s\n",
+           "scene", "dense", "dag", "dag/dense", "nodes", "leaves", "build", "extract", "lookup", "mismatch");
+    for (u32 i = 0; i < COUNT_OF(worlds); i++)
+        bench_dag(worlds[i]);
+
+    free(updated.vertices);
+    free(mesh.vertices);
+    return 0;
+}
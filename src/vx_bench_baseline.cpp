@@ -0,0 +1,76 @@
+// The mesher of the first commit, create_chunk_vertex_buffer, timed on the scenes of vx_bench.cpp.
+// `make bench-baseline` exports that commit from git and builds this file against its headers
+// and sources, so the numbers compare with the mesher table of `make bench`.
+
+#include <stdio.h>
+#include <string.h>
+#include <GL/glew.h>
+#include "um.hpp"
+#include "vx_chunk_manager.hpp"
+#include "vx_bench_scenes.hpp"
+
+static_assert(SCENE_SIZE == vx::CHUNK_SIZE, "The scenes are single chunks");
+
+// Defined in vx_chunk_manager.cpp of the baseline, which does not declare it in a header.
+void create_chunk_vertex_buffer(vx::Chunk& chunk);
+
+// The baseline mesher also creates and fills the GL buffers of the chunk. No context is created
+// here, so its GL calls go to these and only the meshing is measured.
+static void GLAPIENTRY bench_gen_names(GLsizei n, GLuint* names) { memset(names, 0, sizeof(GLuint) * n); }
+static void GLAPIENTRY bench_bind_vertex_array(GLuint) {}
+static void GLAPIENTRY bench_bind_buffer(GLenum, GLuint) {}
+static void GLAPIENTRY bench_buffer_data(GLenum, GLsizeiptr, const void*, GLenum) {}
+static void GLAPIENTRY bench_enable_attrib(GLuint) {}
+static void GLAPIENTRY bench_attrib_pointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {}
+
+static volatile u64 g_sink;
+
+void
+bench_baseline_mesher(const Scene& scene, vx::Chunk& chunk)
+{
+    static constexpr u32 ITERATIONS = 200;
+
+    memset(chunk.blocks, 0, sizeof(chunk.blocks));
+    for (i32 x = 0; x < SCENE_SIZE; x++)
+        for (i32 y = 0; y < SCENE_SIZE; y++)
+            for (i32 z = 0; z < SCENE_SIZE; z++)
+                chunk.blocks[x][y][z].exists = (scene.columns[x][z] >> y) & 1;
+    chunk.position = glm::vec3(0.0f);
+
+    f64 mesh_ns;
+    {
+        Timer timer;
+        for (u32 i = 0; i < ITERATIONS; i++)
+        {
+            create_chunk_vertex_buffer(chunk);
+            g_sink += chunk.num_vertices;
+        }
+        mesh_ns = timer.elapsed_ns() / ITERATIONS;
+    }
+
+    // num_vertices counts the vec3s, a position and a normal for each of the 6 vertices of a quad.
+    printf("%-8s %10s %10u %10u %10.0f\n", scene.name, "-", chunk.num_vertices / 12,
+           (u32)(chunk.num_vertices * sizeof(glm::vec3)), mesh_ns);
+}
+
+int
+main()
+{
+    __glewGenVertexArrays = bench_gen_names;
+    __glewGenBuffers = bench_gen_names;
+    __glewBindVertexArray = bench_bind_vertex_array;
+    __glewBindBuffer = bench_bind_buffer;
+    __glewBufferData = bench_buffer_data;
+    __glewEnableVertexAttribArray = bench_enable_attrib;
+    __glewVertexAttribPointer = bench_attrib_pointer;
+
+    static Scene scenes[NUM_SCENES];
+    generate_scenes(scenes);
+    static vx::Chunk chunk;
+
+    printf("Baseline mesher, time per chunk in ns, GL calls excluded.\n\n");
+    printf("%-8s %10s %10s %10s %10s\n", "scene", "faces", "quads", "bytes", "mesh");
+    for (u32 i = 0; i < NUM_SCENES; i++)
+        bench_baseline_mesher(scenes[i], chunk);
+    return 0;
+}
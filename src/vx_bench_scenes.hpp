@@ -0,0 +1,76 @@
+#ifndef VX_BENCH_SCENES_HPP
+#define VX_BENCH_SCENES_HPP
+
+// Scenes and timer shared by vx_bench.cpp and vx_bench_baseline.cpp. The baseline benchmark is
+// built against the headers of another commit, so this only depends on um.hpp and the noise.
+
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include "um.hpp"
+#include "open-simplex-noise.h"
+
+// Same as vx::CHUNK_SIZE, which both benchmarks check.
+static constexpr i32 SCENE_SIZE = 32;
+
+// Indexed [x][z], bit y is set if the block at that height exists.
+typedef u32 Columns[SCENE_SIZE][SCENE_SIZE];
+
+struct Scene
+{
+    const char* name;
+    Columns     columns;
+};
+
+struct Timer
+{
+    std::chrono::high_resolution_clock::time_point start;
+
+    Timer(): start(std::chrono::high_resolution_clock::now()) {}
+
+    f64 elapsed_ns() const
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<f64, std::nano>(end - start).count();
+    }
+};
+
+static constexpr u32 NUM_SCENES = 3;
+
+inline void
+generate_scenes(Scene* scenes)
+{
+    struct osn_context* ctx;
+    int noise_result = open_simplex_noise(1234, &ctx);
+    ASSERT(noise_result == 0);
+
+    // Rolling hills, most columns are a single run of blocks.
+    scenes[0].name = "terrain";
+    for (i32 x = 0; x < SCENE_SIZE; x++)
+        for (i32 z = 0; z < SCENE_SIZE; z++)
+        {
+            f64 noise = open_simplex_noise2(ctx, x * 0.05, z * 0.05);
+            i32 height = 16 + (i32)(noise * 12.0);
+            scenes[0].columns[x][z] = (height >= 32) ? ~0u : ((1u << height) - 1);
+        }
+
+    // Caves, blocks are kept where the 3D noise is positive.
+    scenes[1].name = "caves";
+    memset(scenes[1].columns, 0, sizeof(Columns));
+    for (i32 x = 0; x < SCENE_SIZE; x++)
+        for (i32 z = 0; z < SCENE_SIZE; z++)
+            for (i32 y = 0; y < SCENE_SIZE; y++)
+                if (open_simplex_noise3(ctx, x * 0.1, y * 0.1, z * 0.1) > -0.1)
+                    scenes[1].columns[x][z] |= 1u << y;
+
+    // Noise, the worst case for meshing.
+    scenes[2].name = "random";
+    srand(1234);
+    for (i32 x = 0; x < SCENE_SIZE; x++)
+        for (i32 z = 0; z < SCENE_SIZE; z++)
+            scenes[2].columns[x][z] = ((u32)rand() << 16) ^ (u32)rand();
+
+    open_simplex_noise_free(ctx);
+}
+
+#endif // VX_BENCH_SCENES_HPP
@@ -0,0 +1,315 @@
+#include "vx_block_palette.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+// Index width needed for a palette with the given number of entries. Only powers of two are
+// used, so an index never straddles two words.
+u32
+bits_for_types(u32 num_types)
+{
+    if (num_types <= 1)   return 0;
+    if (num_types <= 2)   return 1;
+    if (num_types <= 4)   return 2;
+    if (num_types <= 16)  return 4;
+    if (num_types <= 256) return 8;
+    return 16;
+}
+
+// Linear search, palettes of real chunks rarely have more than a handful of entries.
+// @Performance: If chunks with lots of types become common, this should be a hash lookup.
+u32
+find_type(const vx::BlockType* types, const u16* refcounts, u32 num_types, vx::BlockType type)
+{
+    for (u32 i = 0; i < num_types; i++)
+        if (types[i] == type && refcounts[i] > 0)
+            return i;
+    return num_types;
+}
+
+u32
+read_entry(const u64* data, u32 bits, u32 index)
+{
+    const u32 per_word = 64 / bits;
+    return (data[index / per_word] >> ((index % per_word) * bits)) & ((1u << bits) - 1);
+}
+
+void
+write_entry(u64* data, u32 bits, u32 index, u32 entry)
+{
+    const u32 per_word = 64 / bits;
+    const u32 shift = (index % per_word) * bits;
+    const u64 mask = (u64)((1u << bits) - 1) << shift;
+    data[index / per_word] = (data[index / per_word] & ~mask) | ((u64)entry << shift);
+}
+
+void
+vx::BlockPalette::destroy()
+{
+    free(this->types);
+    free(this->refcounts);
+    free(this->data);
+    memset(this, 0, sizeof(*this));
+}
+
+void
+vx::BlockPalette::clear()
+{
+    this->num_types = 0;
+    this->bits = 0;
+}
+
+void
+vx::BlockPalette::copy(const vx::BlockPalette& other)
+{
+    this->num_types = other.num_types;
+    if (other.num_types > 0)
+    {
+        reserve(other.num_types);
+        memcpy(this->types, other.types, sizeof(vx::BlockType) * other.num_types);
+        memcpy(this->refcounts, other.refcounts, sizeof(u16) * other.num_types);
+    }
+    this->bits = other.bits;
+    if (other.bits > 0)
+    {
+        reserve_data(LENGTH / 64 * other.bits);
+        memcpy(this->data, other.data, sizeof(u64) * (LENGTH / 64 * other.bits));
+    }
+}
+
+vx::BlockType
+vx::BlockPalette::get(u32 index) const
+{
+    ASSERT(index < LENGTH);
+    if (this->num_types == 0) return BLOCK_AIR;
+    if (this->bits == 0) return this->types[0];
+    return this->types[read_entry(this->data, this->bits, index)];
+}
+
+void
+vx::BlockPalette::set(u32 index, vx::BlockType type)
+{
+    ASSERT(index < LENGTH);
+    if (this->num_types == 0)
+    {
+        // Zeroed palette, make the implicit air entry explicit.
+        reserve(1);
+        this->types[0] = BLOCK_AIR;
+        this->refcounts[0] = LENGTH;
+        this->num_types = 1;
+    }
+
+    const u32 old_entry = this->bits ? read_entry(this->data, this->bits, index) : 0;
+    if (this->types[old_entry] == type) return;
+
+    const u32 new_entry = find_or_add(type);
+    this->refcounts[old_entry]--;
+    this->refcounts[new_entry]++;
+    write_entry(this->data, this->bits, index, new_entry);
+}
+
+void
+vx::BlockPalette::get_all(vx::BlockType* out) const
+{
+    if (this->bits == 0)
+    {
+        const vx::BlockType type = this->num_types > 0 ? this->types[0] : BLOCK_AIR;
+        for (u32 i = 0; i < LENGTH; i++)
+            out[i] = type;
+        return;
+    }
+
+    // Unpack a whole word at a time instead of recomputing the word and shift of every index.
+    const u32 per_word = 64 / this->bits;
+    const u64 mask = (1u << this->bits) - 1;
+    for (u32 w = 0, i = 0; w < LENGTH / per_word; w++)
+    {
+        u64 word = this->data[w];
+        for (u32 k = 0; k < per_word; k++, i++)
+        {
+            out[i] = this->types[word & mask];
+            word >>= this->bits;
+        }
+    }
+}
+
+void
+vx::BlockPalette::set_all(const vx::BlockType* in)
+{
+    // First pass builds the palette, so the index width is known before packing anything.
+    // Terrain comes in long runs of the same type, so the last entry found is checked first.
+    this->num_types = 0;
+    u32 entry = 0;
+    for (u32 i = 0; i < LENGTH; i++)
+    {
+        if (i == 0 || in[i] != this->types[entry])
+        {
+            entry = find_type(this->types, this->refcounts, this->num_types, in[i]);
+            if (entry == this->num_types)
+            {
+                reserve(this->num_types + 1);
+                this->types[entry] = in[i];
+                this->refcounts[entry] = 0;
+                this->num_types++;
+            }
+        }
+        this->refcounts[entry]++;
+    }
+
+    this->bits = bits_for_types(this->num_types);
+    if (this->bits == 0) return;
+
+    const u32 per_word = 64 / this->bits;
+    reserve_data(LENGTH / per_word);
+
+    for (u32 w = 0, i = 0; w < LENGTH / per_word; w++)
+    {
+        u64 word = 0;
+        for (u32 k = 0; k < per_word; k++, i++)
+        {
+            if (in[i] != this->types[entry])
+                entry = find_type(this->types, this->refcounts, this->num_types, in[i]);
+            word |= (u64)entry << (k * this->bits);
+        }
+        this->data[w] = word;
+    }
+}
+
+void
+vx::BlockPalette::compact()
+{
+    if (this->num_types == 0) return;
+
+    // Move the used entries to the front, remembering where each one went.
+    u16* remap = (u16*)malloc(sizeof(u16) * this->num_types);
+    ASSERT(remap != NULL);
+    u32 num_used = 0;
+    for (u32 i = 0; i < this->num_types; i++)
+    {
+        if (this->refcounts[i] == 0) continue;
+        remap[i] = num_used;
+        this->types[num_used] = this->types[i];
+        this->refcounts[num_used] = this->refcounts[i];
+        num_used++;
+    }
+    ASSERT(num_used > 0);
+
+    if (num_used != this->num_types)
+    {
+        this->num_types = num_used;
+        repack(bits_for_types(num_used), remap);
+    }
+    free(remap);
+
+    // Unlike clear, compaction is done to save memory, so the packed indices are trimmed too.
+    const u32 num_words = LENGTH / 64 * this->bits;
+    if (num_words < this->data_capacity)
+    {
+        if (num_words == 0)
+        {
+            free(this->data);
+            this->data = nullptr;
+        }
+        else
+        {
+            this->data = (u64*)realloc(this->data, sizeof(u64) * num_words);
+            ASSERT(this->data != NULL);
+        }
+        this->data_capacity = num_words;
+    }
+}
+
+u32
+vx::BlockPalette::memory_usage() const
+{
+    return sizeof(*this) +
+        this->capacity * (sizeof(vx::BlockType) + sizeof(u16)) +
+        this->data_capacity * sizeof(u64);
+}
+
+u32
+vx::BlockPalette::find_or_add(vx::BlockType type)
+{
+    // Entries that are not used anymore are recycled before the palette is made any bigger.
+    u32 free_entry = this->num_types;
+    for (u32 i = 0; i < this->num_types; i++)
+    {
+        if (this->refcounts[i] == 0)
+        {
+            if (free_entry == this->num_types) free_entry = i;
+        }
+        else if (this->types[i] == type)
+        {
+            return i;
+        }
+    }
+
+    if (free_entry == this->num_types)
+    {
+        const u32 max_types = this->bits == 0 ? 1 : (1u << this->bits);
+        if (this->num_types == max_types)
+            repack(bits_for_types(this->num_types + 1), nullptr);
+        reserve(this->num_types + 1);
+        this->num_types++;
+    }
+    this->types[free_entry] = type;
+    this->refcounts[free_entry] = 0;
+    return free_entry;
+}
+
+void
+vx::BlockPalette::reserve(u32 new_capacity)
+{
+    if (new_capacity <= this->capacity) return;
+
+    this->capacity = MAX(new_capacity, MAX(4, this->capacity * 2));
+    this->types = (vx::BlockType*)realloc(this->types, sizeof(vx::BlockType) * this->capacity);
+    this->refcounts = (u16*)realloc(this->refcounts, sizeof(u16) * this->capacity);
+    ASSERT(this->types != NULL && this->refcounts != NULL);
+}
+
+void
+vx::BlockPalette::reserve_data(u32 new_capacity)
+{
+    if (new_capacity <= this->data_capacity) return;
+
+    this->data_capacity = new_capacity;
+    this->data = (u64*)realloc(this->data, sizeof(u64) * this->data_capacity);
+    ASSERT(this->data != NULL);
+}
+
+void
+vx::BlockPalette::repack(u32 new_bits, const u16* remap)
+{
+    const u32 old_bits = this->bits;
+    this->bits = new_bits;
+    if (new_bits == 0) return;
+
+    reserve_data(LENGTH / 64 * new_bits);
+    if (old_bits == 0)
+    {
+        const u32 entry = remap ? remap[0] : 0;
+        for (u32 i = 0; i < LENGTH; i++)
+            write_entry(this->data, new_bits, i, entry);
+        return;
+    }
+
+    // The indices are repacked in place. Index i starts at bit i*bits, so when the indices
+    // get wider they are moved starting from the last one, and from the first one when they
+    // get narrower. That way an index is never overwritten before it is read.
+    if (new_bits >= old_bits)
+    {
+        for (u32 i = LENGTH; i-- > 0;)
+        {
+            u32 entry = read_entry(this->data, old_bits, i);
+            write_entry(this->data, new_bits, i, remap ? remap[entry] : entry);
+        }
+    }
+    else
+    {
+        for (u32 i = 0; i < LENGTH; i++)
+        {
+            u32 entry = read_entry(this->data, old_bits, i);
+            write_entry(this->data, new_bits, i, remap ? remap[entry] : entry);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef VX_BLOCK_PALETTE_HPP
+#define VX_BLOCK_PALETTE_HPP
+
+#include "um.hpp"
+
+namespace vx
+{
+
+// Id of a block type. What each id means is up to the game, the engine only knows about air.
+typedef u16 BlockType;
+
+static constexpr BlockType BLOCK_AIR = 0;
+
+// Block types of a chunk, stored as a small table of distinct types (the palette) plus one
+// packed index into that table per block. The index width is the smallest power of two that
+// fits the palette (0, 1, 2, 4, 8 or 16 bits), so a chunk with two types costs a single bit
+// per block, and a chunk with a single type costs nothing besides the table.
+//
+// A zeroed palette is valid and holds only air, so it can live inside calloc'ed structs.
+struct BlockPalette
+{
+    // One entry per block of a chunk.
+    static constexpr u32 LENGTH = 32 * 32 * 32;
+
+    BlockType* types;     // palette entries, indexed by the packed indices
+    u16*       refcounts; // number of blocks using each entry, unused entries are zero
+    u32        num_types; // entries at the start of the table, some may have a zero refcount
+    u32        capacity;  // allocated entries of types and refcounts
+    u32        bits;      // width of each packed index
+    u64*       data;      // LENGTH packed indices, not used when bits is zero
+    u32        data_capacity; // allocated words of data
+
+    void destroy();
+    // Back to only air, keeping the allocations around to be reused.
+    void clear();
+    // Makes this palette hold the same blocks as other, reusing its own allocations.
+    void copy(const BlockPalette& other);
+
+    BlockType get(u32 index) const;
+    void      set(u32 index, BlockType type);
+
+    // Bulk versions of get and set, working on LENGTH block types at once.
+    void      get_all(BlockType* out) const;
+    void      set_all(const BlockType* in);
+
+    // Removes the unused entries from the palette and shrinks the index width if possible.
+    void      compact();
+
+    u32       memory_usage() const;
+
+private:
+    u32       find_or_add(BlockType type);
+    void      reserve(u32 new_capacity);
+    void      reserve_data(u32 new_capacity);
+    void      repack(u32 new_bits, const u16* remap);
+};
+
+}
+
+#endif // VX_BLOCK_PALETTE_HPP
@@ -0,0 +1,131 @@
+#include "vx_buffer_allocator.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+vx::BufferAllocator::BufferAllocator(u32 capacity)
+    : _num_free(0)
+    , _free_capacity(16)
+    , _capacity(capacity)
+    , _used(0)
+{
+    _free_ranges = (Range*)malloc(sizeof(Range) * _free_capacity);
+    ASSERT(_free_ranges != NULL);
+    if (capacity > 0)
+        _free_ranges[_num_free++] = Range{0, capacity};
+}
+
+vx::BufferAllocator::~BufferAllocator()
+{
+    ::free(_free_ranges);
+}
+
+void
+vx::BufferAllocator::insert_free(u32 index, Range range)
+{
+    if (_num_free == _free_capacity)
+    {
+        _free_capacity *= 2;
+        _free_ranges = (Range*)realloc(_free_ranges, sizeof(Range) * _free_capacity);
+        ASSERT(_free_ranges != NULL);
+    }
+    memmove(_free_ranges + index + 1, _free_ranges + index, sizeof(Range) * (_num_free - index));
+    _free_ranges[index] = range;
+    _num_free++;
+}
+
+u32
+vx::BufferAllocator::allocate(u32 size)
+{
+    ASSERT(size > 0);
+
+    u32 best = INVALID;
+    for (u32 i = 0; i < _num_free; i++)
+    {
+        const u32 free_size = _free_ranges[i].size;
+        if (free_size < size) continue;
+        if (best == INVALID || free_size < _free_ranges[best].size)
+        {
+            best = i;
+            if (free_size == size) break;
+        }
+    }
+    if (best == INVALID) return INVALID;
+
+    // Taken from the start of the range, the rest stays free where it was in the list.
+    Range& range = _free_ranges[best];
+    const u32 offset = range.offset;
+    range.offset += size;
+    range.size -= size;
+    if (range.size == 0)
+    {
+        memmove(_free_ranges + best, _free_ranges + best + 1, sizeof(Range) * (_num_free - best - 1));
+        _num_free--;
+    }
+    _used += size;
+    return offset;
+}
+
+void
+vx::BufferAllocator::free(u32 offset, u32 size)
+{
+    ASSERT(size > 0 && offset + size <= _capacity);
+    ASSERT(_used >= size);
+
+    // First free range after the freed one.
+    u32 lo = 0, hi = _num_free;
+    while (lo < hi)
+    {
+        const u32 mid = (lo + hi) / 2;
+        if (_free_ranges[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    const u32 next = lo;
+    ASSERT(next == _num_free || offset + size <= _free_ranges[next].offset);
+    ASSERT(next == 0 || _free_ranges[next-1].offset + _free_ranges[next-1].size <= offset);
+
+    const bool merge_prev = next > 0 && _free_ranges[next-1].offset + _free_ranges[next-1].size == offset;
+    const bool merge_next = next < _num_free && offset + size == _free_ranges[next].offset;
+    if (merge_prev && merge_next)
+    {
+        _free_ranges[next-1].size += size + _free_ranges[next].size;
+        memmove(_free_ranges + next, _free_ranges + next + 1, sizeof(Range) * (_num_free - next - 1));
+        _num_free--;
+    }
+    else if (merge_prev)
+    {
+        _free_ranges[next-1].size += size;
+    }
+    else if (merge_next)
+    {
+        _free_ranges[next].offset = offset;
+        _free_ranges[next].size += size;
+    }
+    else
+    {
+        insert_free(next, Range{offset, size});
+    }
+    _used -= size;
+}
+
+void
+vx::BufferAllocator::grow(u32 new_capacity)
+{
+    ASSERT(new_capacity > _capacity);
+
+    const u32 added = new_capacity - _capacity;
+    Range* last = (_num_free > 0) ? &_free_ranges[_num_free-1] : nullptr;
+    if (last != nullptr && last->offset + last->size == _capacity)
+        last->size += added;
+    else
+        insert_free(_num_free, Range{_capacity, added});
+    _capacity = new_capacity;
+}
+
+u32
+vx::BufferAllocator::largest_free() const
+{
+    u32 largest = 0;
+    for (u32 i = 0; i < _num_free; i++)
+        largest = MAX(largest, _free_ranges[i].size);
+    return largest;
+}
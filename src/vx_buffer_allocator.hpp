@@ -0,0 +1,56 @@
+#ifndef VX_BUFFER_ALLOCATOR_HPP
+#define VX_BUFFER_ALLOCATOR_HPP
+
+#include "um.hpp"
+
+namespace vx
+{
+
+// Hands out ranges of a large buffer, e.g. the vertices of every chunk mesh in a single GL
+// buffer. Nothing here touches OpenGL, the owner of the buffer copies the data when it grows.
+// Sizes and offsets are in whatever unit the owner uses, e.g. vertices.
+//
+// The free ranges are kept sorted by offset, so a freed range is merged with the free ones
+// around it. Allocations take the smallest free range that fits, which keeps the large ones
+// for the large meshes.
+struct BufferAllocator
+{
+    static constexpr u32 INVALID = 0xFFFFFFFF;
+
+    explicit BufferAllocator(u32 capacity);
+    ~BufferAllocator();
+
+    // Returns the offset of the range, or INVALID if no free range is large enough. The owner
+    // can grow the buffer and try again then.
+    u32  allocate(u32 size);
+    // The range must have been returned by allocate with the same size.
+    void free(u32 offset, u32 size);
+    // Makes [capacity, new_capacity) free, after the owner grew the buffer.
+    void grow(u32 new_capacity);
+
+    u32  capacity() const { return _capacity; }
+    // Sum of the sizes of the ranges in use.
+    u32  used() const { return _used; }
+    // Largest range that allocate would succeed with right now.
+    u32  largest_free() const;
+
+private:
+    struct Range
+    {
+        u32 offset;
+        u32 size;
+    };
+
+    Range* _free_ranges;
+    u32    _num_free;
+    u32    _free_capacity;
+    u32    _capacity;
+    u32    _used;
+
+    // Inserts a free range at index of the sorted list.
+    void insert_free(u32 index, Range range);
+};
+
+}
+
+#endif // VX_BUFFER_ALLOCATOR_HPP
@@ -0,0 +1,221 @@
+#include "vx_chunk_builder.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include "open-simplex-noise.h"
+
+// Fills the blocks of the chunk at position, indexed by Chunk::block_index.
+void
+generate_chunk_blocks(glm::vec3 position, vx::BlockType* types)
+{
+    using vec3 = glm::vec3;
+    using namespace vx;
+
+    // TODO:
+    // This method of deciding which block is filled inside a chunk should eventually be refactored.
+    // The blocks only depend on the position, nothing here may touch global state like rand,
+    // since every worker runs it at the same time.
+    struct osn_context *ctx;
+    int noise_result = open_simplex_noise(0, &ctx);
+    ASSERT(noise_result == 0);
+    for (int z = 0; z < CHUNK_SIZE; z++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int x = 0; x < CHUNK_SIZE; x++)
+            {
+                vec3 blockPosition;
+                blockPosition.x = position.x + (BLOCK_SIZE * x);
+                blockPosition.y = position.y + (BLOCK_SIZE * y);
+                blockPosition.z = position.z + (BLOCK_SIZE * z);
+                // f64 noise = get_noise(
+                //     blockPosition.x,
+                //     blockPosition.y,
+                //     blockPosition.z, 0.05, 2.0, 0.25, ctx);
+                // bool exists = noise > 0.1 ? false : true;
+                bool exists = true;
+
+                /* bool exists = (rand() % 20) > 10 ? true : false; */
+                /* if (z == CHUNK_SIZE-1 && (x == 0 || x == 1 || x == 3 || x == 2)) */
+                /*     exists = true; */
+                /* else */
+                /*     exists = false; */
+                types[vx::Chunk::block_index(x, y, z)] = exists ? BLOCK_GROUND : BLOCK_AIR;
+            }
+        }
+    }
+    // for (i32 i = CHUNK_SIZE-1; i >= 0; i--)
+    // {
+    //     types[vx::Chunk::block_index(i, CHUNK_SIZE-1, CHUNK_SIZE-1)] = BLOCK_AIR;
+    // }
+
+    open_simplex_noise_free(ctx);
+}
+
+void
+vx::build_chunk(vx::ChunkBuildJob& job)
+{
+    vx::Chunk& chunk = *job.chunk;
+
+    // The blocks are generated on the stack first, so uniform chunks never allocate voxels.
+    vx::BlockType types[BlockPalette::LENGTH];
+    generate_chunk_blocks(chunk.position, types);
+    chunk.set_blocks(types);
+
+    chunk.mesh.num_vertices = 0;
+    if (chunk.storage->fill == CHUNK_EMPTY)
+        return;
+
+    // Both the mesh and the occluders are built from the columns, they are only extracted once.
+    // The vertices of the chunk were kept by the pool, so they only grow until the chunks
+    // reach the size of the meshes being built.
+    u32 columns[CHUNK_SIZE][CHUNK_SIZE];
+    chunk.get_columns(columns);
+    vx::build_chunk_mesh(columns, job.borders, chunk.mesh, job.mesh_mode);
+    vx::build_chunk_occluders(columns, chunk.position, job.occluders);
+}
+
+void
+vx::remesh_chunk(vx::ChunkBuildJob& job)
+{
+    u32 columns[CHUNK_SIZE][CHUNK_SIZE];
+    job.snapshot.storage->get_columns(columns);
+
+    u32 num_dirty_slices = 0;
+    for (u32 face = 0; face < FACE_COUNT; face++)
+        num_dirty_slices += um::popcount(job.dirty.masks[face]);
+    if (num_dirty_slices > vx::MAX_DIRTY_SLICES)
+    {
+        vx::build_chunk_mesh(columns, job.borders, job.mesh, job.old_mesh.mode);
+        job.first_changed = 0;
+        job.changed_end = job.mesh.num_vertices;
+    }
+    else
+    {
+        job.first_changed = vx::update_chunk_mesh(columns, job.borders, job.dirty, job.old_mesh, job.mesh,
+                                                  job.changed_end);
+    }
+    vx::build_chunk_occluders(columns, job.snapshot.position, job.occluders);
+}
+
+void*
+run_chunk_worker(void* arg)
+{
+    vx::ChunkBuilder::Worker& worker = *(vx::ChunkBuilder::Worker*)arg;
+    vx::ChunkBuilder& builder = *worker.builder;
+    while (true)
+    {
+        while (sem_wait(&builder.pending) != 0)
+            ASSERT(errno == EINTR);
+
+        vx::ChunkBuildJob* job;
+        // The destructor may have taken the job already.
+        if (!builder.jobs.pop(job)) continue;
+        // Pushed by the destructor to stop the worker.
+        if (job == nullptr) break;
+
+        if (job->kind == vx::JOB_REMESH)
+            vx::remesh_chunk(*job);
+        else
+            vx::build_chunk(*job);
+
+        // Never full, there are no more jobs than it holds.
+        const bool pushed = builder.results.push(job);
+        ASSERT(pushed);
+    }
+    return nullptr;
+}
+
+vx::ChunkBuilder::ChunkBuilder(u32 num_workers)
+    : jobs(QUEUE_SIZE)
+    , results(QUEUE_SIZE)
+    , num_workers(num_workers)
+    , num_free_jobs(QUEUE_SIZE)
+{
+    ASSERT(num_workers > 0);
+    int sem_result = sem_init(&this->pending, 0, 0);
+    ASSERT(sem_result == 0);
+
+    this->job_storage = (ChunkBuildJob*)calloc(QUEUE_SIZE, sizeof(ChunkBuildJob));
+    this->free_jobs = (ChunkBuildJob**)malloc(sizeof(ChunkBuildJob*) * QUEUE_SIZE);
+    ASSERT(this->job_storage != NULL && this->free_jobs != NULL);
+    for (u32 i = 0; i < QUEUE_SIZE; i++)
+        this->free_jobs[i] = &this->job_storage[i];
+
+    this->workers = (Worker*)malloc(sizeof(Worker) * num_workers);
+    ASSERT(this->workers != NULL);
+    for (u32 i = 0; i < num_workers; i++)
+    {
+        Worker& worker = this->workers[i];
+        worker.builder = this;
+        int thread_result = pthread_create(&worker.thread, NULL, run_chunk_worker, &worker);
+        ASSERT(thread_result == 0);
+    }
+}
+
+vx::ChunkBuilder::~ChunkBuilder()
+{
+    stop();
+    for (u32 i = 0; i < QUEUE_SIZE; i++)
+        free(this->job_storage[i].mesh.vertices);
+    free(this->job_storage);
+    free(this->free_jobs);
+    sem_destroy(&this->pending);
+}
+
+void
+vx::ChunkBuilder::stop()
+{
+    // Jobs that no worker took yet come back unbuilt, so the workers see the stop jobs right
+    // away. The results have room for every job.
+    vx::ChunkBuildJob* job;
+    while (this->jobs.pop(job))
+    {
+        const bool pushed = this->results.push(job);
+        ASSERT(pushed);
+    }
+
+    for (u32 i = 0; i < this->num_workers; i++)
+    {
+        while (!this->jobs.push(nullptr))
+            sched_yield();
+        sem_post(&this->pending);
+    }
+    for (u32 i = 0; i < this->num_workers; i++)
+        pthread_join(this->workers[i].thread, NULL);
+
+    free(this->workers);
+    this->workers = nullptr;
+    this->num_workers = 0;
+}
+
+vx::ChunkBuildJob*
+vx::ChunkBuilder::acquire_job()
+{
+    if (this->num_free_jobs == 0) return nullptr;
+    return this->free_jobs[--this->num_free_jobs];
+}
+
+void
+vx::ChunkBuilder::release_job(vx::ChunkBuildJob* job)
+{
+    ASSERT(this->num_free_jobs < QUEUE_SIZE);
+    this->free_jobs[this->num_free_jobs++] = job;
+}
+
+bool
+vx::ChunkBuilder::submit(vx::ChunkBuildJob* job)
+{
+    ASSERT(job != nullptr);
+    if (!this->jobs.push(job)) return false;
+    sem_post(&this->pending);
+    return true;
+}
+
+vx::ChunkBuildJob*
+vx::ChunkBuilder::finished()
+{
+    vx::ChunkBuildJob* job;
+    return this->results.pop(job) ? job : nullptr;
+}
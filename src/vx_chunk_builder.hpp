@@ -0,0 +1,105 @@
+#ifndef VX_CHUNK_BUILDER_HPP
+#define VX_CHUNK_BUILDER_HPP
+
+#include <pthread.h>
+#include <semaphore.h>
+#include "um.hpp"
+#include "vx_chunk_manager.hpp"
+#include "vx_chunk_mesh.hpp"
+#include "vx_atomic_queue.hpp"
+
+namespace vx
+{
+
+enum ChunkJobKind
+{
+    // Generates the blocks of a new chunk, then meshes it, see build_chunk.
+    JOB_BUILD,
+    // Meshes the dirty slices of a chunk in the manager again, see remesh_chunk.
+    JOB_REMESH,
+};
+
+// Work on one chunk done away from the render thread, its meshing and occluders.
+struct ChunkBuildJob
+{
+    ChunkJobKind         kind;
+    // Neighbours loaded when the job was queued. A new chunk checks them again when it is added,
+    // a remeshed one has its border slices marked dirty when they change.
+    ChunkBorders         borders;
+
+    // JOB_BUILD. Set when the job is queued. The chunk is acquired from the pool but not added
+    // to the manager yet, so the builder thread is the only one touching it until the job is
+    // back. Its mesh is built into the one of the chunk.
+    Chunk*               chunk;
+    Shader*              shader;
+    u32                  material;
+    ChunkMeshMode        mesh_mode;
+
+    // JOB_REMESH. The blocks are read from the snapshot, so the chunk can be edited while the
+    // job runs, and old_mesh is the mesh of the chunk when the job was queued. The chunk
+    // leaves it untouched until the job is back, see Chunk::remeshing.
+    ChunkSnapshot        snapshot;
+    ChunkHandle          handle;
+    ChunkDirtySlices     dirty;
+    ChunkMesh            old_mesh;
+    // Set by remesh_chunk, the same as for update_chunk_mesh. The vertices of the mesh are
+    // kept with the job for the next remeshes.
+    ChunkMesh            mesh;
+    u32                  first_changed;
+    u32                  changed_end;
+
+    // Set by both kinds.
+    ChunkOccluders       occluders;
+};
+
+// Fills the blocks of the chunk of the job, then builds its mesh into the mesh of the chunk,
+// and its occluders. Safe to call on any thread.
+void build_chunk(ChunkBuildJob& job);
+// Meshes the dirty slices of the snapshot again into the mesh of the job, or the whole chunk
+// when too many are dirty, and builds its occluders. Safe to call on any thread.
+void remesh_chunk(ChunkBuildJob& job);
+
+// Pool of threads running build_chunk and remesh_chunk. Jobs go in and come back through lock
+// free queues, so the render thread never waits for them; only the GL upload of the results is
+// left to it. The workers sleep on a semaphore while there is nothing to build.
+struct ChunkBuilder
+{
+    static constexpr u32 QUEUE_SIZE = 256;
+
+    struct Worker
+    {
+        ChunkBuilder*    builder;
+        pthread_t        thread;
+    };
+
+    AtomicQueue<ChunkBuildJob*> jobs;
+    AtomicQueue<ChunkBuildJob*> results;
+    // Counts the jobs that were pushed and not taken by a worker yet.
+    sem_t                pending;
+    Worker*              workers;
+    u32                  num_workers;
+    // QUEUE_SIZE jobs allocated once. There are never more jobs than the queues hold, so a
+    // worker always has room for its result.
+    ChunkBuildJob*       job_storage;
+    ChunkBuildJob**      free_jobs;
+    u32                  num_free_jobs;
+
+    explicit ChunkBuilder(u32 num_workers);
+    ~ChunkBuilder();
+
+    // Returns nullptr while all the jobs are in flight. Only called by the thread that submits
+    // the jobs, as is release_job.
+    ChunkBuildJob* acquire_job();
+    void           release_job(ChunkBuildJob* job);
+    // Returns false if too many jobs are queued already, the job is left to the caller.
+    bool submit(ChunkBuildJob* job);
+    // Returns nullptr if no job is finished. Never waits.
+    ChunkBuildJob* finished();
+    // Joins the workers. Jobs that no worker took are put in the results unbuilt, so every job
+    // that was submitted comes back through finished, and its chunk can go back to the pool.
+    void stop();
+};
+
+}
+
+#endif // VX_CHUNK_BUILDER_HPP
@@ -1,10 +1,12 @@
 #include "vx_chunk_manager.hpp"
+#include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
+#include <algorithm>
 #include "vx_shader_manager.hpp"
 #include "vx_camera.hpp"
 #include "vx_material.hpp"
@@ -14,18 +16,20 @@
 #include "vx_frustum.hpp"
 #include "vx_memory.hpp"
 #include "vx_display.hpp"
+#include "vx_chunk_builder.hpp"
+#include "vx_stream_buffer.hpp"
 #include "um.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
-void create_chunk_vertex_buffer(vx::Chunk& chunk);
+void set_chunk_vertex_format(const vx::ChunkManager& manager);
+void upload_chunk_mesh(vx::ChunkManager& manager, vx::Chunk& chunk, const vx::ChunkMesh& mesh, u32 first_changed,
+                       u32 changed_end, vx::ChunkRenderInfo& info);
+vx::Chunk& acquire_chunk(vx::ChunkManager& manager, vx::ChunkCoord coord);
+u32 add_chunk(vx::ChunkManager& manager, vx::Chunk& chunk, u32 shader, u32 material);
+void end_remesh(vx::ChunkManager& manager, vx::ChunkBuildJob& job, bool upload);
 f64 get_noise(f64 x, f64 y, f64 z, f64 startFrequence, u32 octaveCount, f64 persistence, struct osn_context* ctx);
 f64 get_noise_2D(f64 x, f64 y, f64 startFrequence, u32 octaveCount, f64 persistence, struct osn_context *ctx);
 
-enum Axis
-{
-    AXIS_X, AXIS_Y, AXIS_Z,
-};
-
 struct SlidingBuffer
 {
     i32 data[vx::CHUNK_SIZE][vx::CHUNK_SIZE];
@@ -48,8 +52,8 @@ find_first_valid_position(um::Pairi& res, const SlidingBuffer& sbuf)
     return false;
 }
 
-Quad3*
-find_largest_quad(const SlidingBuffer& sbuf, vx::Chunk& chunk, vx::Face face)
+bool
+find_largest_quad(const SlidingBuffer& sbuf, glm::vec3 position, vx::Face face, Quad3& q)
 {
     using vec3 = glm::vec3;
     //@Improvement, @Performance
@@ -63,7 +67,7 @@ find_largest_quad(const SlidingBuffer& sbuf, vx::Chunk& chunk, vx::Face face)
     // get first index to start iterating from
     um::Pairi startPos;
     if (!find_first_valid_position(startPos, sbuf))
-        return nullptr;
+        return false;
 
     startI = startPos.a;
     startJ = startPos.b;
@@ -72,7 +76,7 @@ find_largest_quad(const SlidingBuffer& sbuf, vx::Chunk& chunk, vx::Face face)
 
     // Rectangles of only 1 of width or height are not accepted.
     if (startI+1 >= vx::CHUNK_SIZE || startJ+1 >= vx::CHUNK_SIZE)
-        return nullptr;
+        return false;
 
     // --------------------------------------
     //              Offsets
@@ -117,7 +121,7 @@ find_largest_quad(const SlidingBuffer& sbuf, vx::Chunk& chunk, vx::Face face)
         i32 prevIVal = sbuf.data[startI][startJ];
         i32 offsetI = sbuf.data[startI+1][startJ] - prevIVal;
 
-        while (endI < vx::CHUNK_SIZE &&
+        while (endI+1 < vx::CHUNK_SIZE &&
                offsetDirectionI == SIGN(offsetI) &&
                abs(offsetI) <= 1 &&
                sbuf.data[startI+1][startJ] != -1)
@@ -147,7 +151,7 @@ find_largest_quad(const SlidingBuffer& sbuf, vx::Chunk& chunk, vx::Face face)
     }
 Exit:;
     if (startI == endI || startJ == endJ)
-        return nullptr;
+        return false;
 
     // Get world position of each of the indexes.
     vec3 p1Offset, p2Offset, p3Offset, p4Offset;
@@ -221,17 +225,17 @@ Exit:;
     f32 half_block = (f32)vx::BLOCK_SIZE/2.0f;
     vec3 half_block_vec(half_block, half_block, half_block);
 
-    Quad3* q = &chunk.occluders_data[face];
-    q->p1 = chunk.position + p1Offset + half_block_vec;
-    q->p2 = chunk.position + p2Offset + half_block_vec;
-    q->p3 = chunk.position + p3Offset + half_block_vec;
-    q->p4 = chunk.position + p4Offset + half_block_vec;
+    q.p1 = position + p1Offset + half_block_vec;
+    q.p2 = position + p2Offset + half_block_vec;
+    q.p3 = position + p3Offset + half_block_vec;
+    q.p4 = position + p4Offset + half_block_vec;
 
-    return q;
+    return true;
 }
 
 void
-create_chunk_occluders(vx::Chunk& chunk)
+vx::build_chunk_occluders(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], glm::vec3 position,
+                           vx::ChunkOccluders& occluders)
 {
     // @Improvement, @Speed: At the moment we are calculating occluders for both opposite faces,
     // i.e. FACE_RIGHT and FACE_LEFT, we could maybe calculate the only one for each axis.
@@ -247,28 +251,26 @@ create_chunk_occluders(vx::Chunk& chunk)
     // Both buffers start with -1 values.
     memset(sbuf_zneg.data, -1, sizeof(sbuf_zneg.data));
     memset(sbuf_zpos.data, -1, sizeof(sbuf_zpos.data));
-    for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+    for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
     {
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
+        // Each bit of the pending masks is a y coordinate that did not find its first block yet.
+        // Walking the z axis one column at a time, every newly found bit is the first block
+        // for that y, so a whole column is resolved with a couple of bit operations.
+        u32 pending_neg = ~0u;
+        u32 pending_pos = ~0u;
+        for (i32 z = 0; z < vx::CHUNK_SIZE && (pending_neg | pending_pos); z++)
         {
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
-            {
-                i32 invIndex = vx::CHUNK_SIZE - 1 - z;
-                // For each slice, find the two 1D voxel buffers.
-                // When the iteration over the X axis is over, merge all of the 1D voxel buffers
-                // into two 2D voxel buffers. They both should generate one occluder each.
+            i32 invIndex = vx::CHUNK_SIZE - 1 - z;
 
-                if (sbuf_zneg.data[y][x] == -1 &&
-                    chunk.blocks[x][y][z].exists)
-                {
-                    sbuf_zneg.data[y][x] = z;
-                }
-                if (sbuf_zpos.data[y][x] == -1 &&
-                    chunk.blocks[x][y][invIndex].exists)
-                {
-                    sbuf_zpos.data[y][x] = invIndex;
-                }
-            }
+            u32 found = columns[x][z] & pending_neg;
+            pending_neg &= ~found;
+            for (; found != 0; found &= found - 1)
+                sbuf_zneg.data[um::count_trailing_zeros(found)][x] = z;
+
+            found = columns[x][invIndex] & pending_pos;
+            pending_pos &= ~found;
+            for (; found != 0; found &= found - 1)
+                sbuf_zpos.data[um::count_trailing_zeros(found)][x] = invIndex;
         }
     }
     // ==================================================
@@ -281,28 +283,24 @@ create_chunk_occluders(vx::Chunk& chunk)
     // Both buffers start with -1 values.
     memset(sbuf_xneg.data, -1, sizeof(sbuf_xneg.data));
     memset(sbuf_xpos.data, -1, sizeof(sbuf_xpos.data));
-    for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+    for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
     {
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
+        // Same as above, walking the x axis instead.
+        u32 pending_neg = ~0u;
+        u32 pending_pos = ~0u;
+        for (i32 x = 0; x < vx::CHUNK_SIZE && (pending_neg | pending_pos); x++)
         {
-            for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
-            {
-                i32 invIndex = vx::CHUNK_SIZE - 1 - x;
-                // For each slice, find the two 1D voxel buffers.
-                // When the iteration over the X axis is over, merge all of the 1D voxel buffers
-                // into two 2D voxel buffers. They both should generate one occluder each.
+            i32 invIndex = vx::CHUNK_SIZE - 1 - x;
 
-                if (sbuf_xneg.data[y][z] == -1 &&
-                    chunk.blocks[x][y][z].exists)
-                {
-                    sbuf_xneg.data[y][z] = x;
-                }
-                if (sbuf_xpos.data[y][z] == -1 &&
-                    chunk.blocks[invIndex][y][z].exists)
-                {
-                    sbuf_xpos.data[y][z] = invIndex;
-                }
-            }
+            u32 found = columns[x][z] & pending_neg;
+            pending_neg &= ~found;
+            for (; found != 0; found &= found - 1)
+                sbuf_xneg.data[um::count_trailing_zeros(found)][z] = x;
+
+            found = columns[invIndex][z] & pending_pos;
+            pending_pos &= ~found;
+            for (; found != 0; found &= found - 1)
+                sbuf_xpos.data[um::count_trailing_zeros(found)][z] = invIndex;
         }
     }
     // ==================================================
@@ -315,1045 +313,1593 @@ create_chunk_occluders(vx::Chunk& chunk)
     // Both buffers start with -1 values.
     memset(sbuf_yneg.data, -1, sizeof(sbuf_yneg.data));
     memset(sbuf_ypos.data, -1, sizeof(sbuf_ypos.data));
-    for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
+    for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
     {
-        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+        for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
         {
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
-            {
-                i32 invIndex = vx::CHUNK_SIZE - 1 - y;
-                // For each slice, find the two 1D voxel buffers.
-                // When the iteration over the X axis is over, merge all of the 1D voxel buffers
-                // into two 2D voxel buffers. They both should generate one occluder each.
+            // The columns run along the y axis, so the lowest and highest blocks are
+            // the lowest and highest set bits of the column.
+            u32 column = columns[x][z];
+            if (column == 0) continue;
 
-                if (sbuf_yneg.data[z][x] == -1 &&
-                    chunk.blocks[x][y][z].exists)
-                {
-                    sbuf_yneg.data[z][x] = y;
-                }
-                if (sbuf_ypos.data[z][x] == -1 &&
-                    chunk.blocks[x][invIndex][z].exists)
-                {
-                    sbuf_ypos.data[z][x] = invIndex;
-                }
-            }
+            sbuf_yneg.data[z][x] = um::count_trailing_zeros(column);
+            sbuf_ypos.data[z][x] = vx::CHUNK_SIZE - 1 - um::count_leading_zeros(column);
         }
     }
     // For each sliding buffer, finds an occluder rectangle. Since we have 6 faces, there are 6 occluders.
     // @SPEED(leo): It does not calculate the *biggest* occluder, so there are room for optimizations.
 
-    // NOTE(leo): if no quad is found, NULL is returned
-    Quad3* xposQuad = find_largest_quad(sbuf_xpos, chunk, vx::FACE_RIGHT);
-    Quad3* xnegQuad = find_largest_quad(sbuf_xneg, chunk, vx::FACE_LEFT);
-    Quad3* yposQuad = find_largest_quad(sbuf_ypos, chunk, vx::FACE_UP);
-    Quad3* ynegQuad = find_largest_quad(sbuf_yneg, chunk, vx::FACE_DOWN);
-    Quad3* zposQuad = find_largest_quad(sbuf_zpos, chunk, vx::FACE_FRONT);
-    Quad3* znegQuad = find_largest_quad(sbuf_zneg, chunk, vx::FACE_BACK);
-
-    chunk.occluders[vx::FACE_RIGHT] = xposQuad;
-    chunk.occluders[vx::FACE_LEFT] = xnegQuad;
-    chunk.occluders[vx::FACE_UP] = yposQuad;
-    chunk.occluders[vx::FACE_DOWN] = ynegQuad;
-    chunk.occluders[vx::FACE_FRONT] = zposQuad;
-    chunk.occluders[vx::FACE_BACK] = znegQuad;
+    // NOTE(leo): if no quad is found, the bit of the face is not set on the mask.
+    const SlidingBuffer* sbufs[vx::FACE_COUNT];
+    sbufs[vx::FACE_RIGHT] = &sbuf_xpos;
+    sbufs[vx::FACE_LEFT] = &sbuf_xneg;
+    sbufs[vx::FACE_UP] = &sbuf_ypos;
+    sbufs[vx::FACE_DOWN] = &sbuf_yneg;
+    sbufs[vx::FACE_FRONT] = &sbuf_zpos;
+    sbufs[vx::FACE_BACK] = &sbuf_zneg;
+
+    occluders.mask = 0;
+    for (u32 face = 0; face < vx::FACE_COUNT; face++)
+    {
+        if (find_largest_quad(*sbufs[face], position, (vx::Face)face, occluders.quads[face]))
+            occluders.mask |= (1u << face);
+    }
 }
 
-vx::ChunkManager::ChunkManager()
-    : position(0.0f, 0.0f, 0.0f)
+void
+allocate_voxels(vx::ChunkStorage& storage)
 {
-    for (u32 i = 0; i < WORLD_SIZE; i++)
-        for (u32 j = 0; j < WORLD_SIZE; j++)
-            for (u32 k = 0; k < WORLD_SIZE; k++)
-            {
-                vx::Chunk* chunk = &this->chunks[i][j][k];
-                memset(chunk, 0, sizeof(*chunk));
-            }
+    if (storage.voxels != nullptr) return;
+
+    storage.voxels = (u64*)malloc(sizeof(u64) * vx::VOXEL_LAYOUT_WORDS);
+    storage.mips = (vx::ChunkMips*)malloc(sizeof(vx::ChunkMips));
+    ASSERT(storage.voxels != NULL && storage.mips != NULL);
 }
 
 void
-vx::ChunkManager::create_chunk(u32 chunkX, u32 chunkY, u32 chunkZ, vx::Shader* shader, vx::Material material)
+vx::ChunkStorage::set_blocks(const vx::BlockType* new_types)
 {
-    using vec3 = glm::vec3;
-    ASSERT(chunkX < WORLD_SIZE && chunkY < WORLD_SIZE && chunkZ < WORLD_SIZE);
+    this->types.set_all(new_types);
+
+    // The palette and the voxels share the same indices, so the layout does not matter here.
+    u64 new_voxels[VOXEL_LAYOUT_WORDS];
+    for (u32 w = 0; w < VOXEL_LAYOUT_WORDS; w++)
+    {
+        const vx::BlockType* word_types = new_types + w * 64;
+        u64 word = 0;
+        for (u32 i = 0; i < 64; i++)
+            word |= (u64)(word_types[i] != BLOCK_AIR) << i;
+        new_voxels[w] = word;
+    }
+    set_voxels(new_voxels);
+}
 
-    // Alias current chunk so it is easier to refer to it.
-    vx::Chunk& chunk = this->chunks[chunkX][chunkY][chunkZ];
+void
+vx::ChunkStorage::set_columns(const u32 new_columns[CHUNK_SIZE][CHUNK_SIZE])
+{
+    u64 new_voxels[VOXEL_LAYOUT_WORDS];
+    ChunkLayout::store_columns(new_voxels, new_columns);
+    set_voxels(new_voxels);
+}
 
-    // Set the world position of the chunks relative to the world position of the manager itself.
-    vec3 position;
-    position.x += chunkX * CHUNK_SIZE * BLOCK_SIZE;
-    position.y += chunkY * CHUNK_SIZE * BLOCK_SIZE;
-    position.z += chunkZ * CHUNK_SIZE * BLOCK_SIZE;
-
-    chunk.material = material;
-    chunk.shader = shader;
-    chunk.position.x = position.x;
-    chunk.position.y = position.y;
-    chunk.position.z = position.z;
-    // Fill all the extreme vertices of the chunk.
-    // The order of them does not matter, they are used for frustum culling.
-    f32 chunk_offset = BLOCK_SIZE * CHUNK_SIZE;
-    chunk.max_vertices[0] = position;
-    chunk.max_vertices[1] = position + vec3(0.0f,         0.0f,         chunk_offset);
-    chunk.max_vertices[2] = position + vec3(0.0f,         chunk_offset, 0.0f);
-    chunk.max_vertices[3] = position + vec3(chunk_offset, 0.0f,         0.0f);
-    chunk.max_vertices[4] = position + vec3(0.0f,         chunk_offset, chunk_offset);
-    chunk.max_vertices[5] = position + vec3(chunk_offset, chunk_offset, 0.0f);
-    chunk.max_vertices[6] = position + vec3(chunk_offset, 0.0f,         chunk_offset);
-    chunk.max_vertices[7] = position + vec3(chunk_offset, chunk_offset, chunk_offset);
-
-    // TODO:
-    // This method of deciding which block is filled inside a chunk should eventually be refactored.
-    //
-    struct osn_context *ctx;
-    u32 num_blocks = 0;
-    ASSERT(open_simplex_noise(0, &ctx) == 0);
-    srand(time(NULL)); // @Test
-    for (int z = 0; z < CHUNK_SIZE; z++)
+void
+vx::ChunkStorage::set_voxels(const u64 new_voxels[VOXEL_LAYOUT_WORDS])
+{
+    u64 any = 0;
+    u64 all = ~0ull;
+    this->num_blocks = 0;
+    for (u32 w = 0; w < VOXEL_LAYOUT_WORDS; w++)
     {
-        for (int y = 0; y < CHUNK_SIZE; y++)
-        {
-            for (int x = 0; x < CHUNK_SIZE; x++)
-            {
-                vec3 position = this->chunks[chunkX][chunkY][chunkZ].position;
-                vec3 blockPosition;
-                blockPosition.x = position.x + (BLOCK_SIZE * x);
-                blockPosition.y = position.y + (BLOCK_SIZE * y);
-                blockPosition.z = position.z + (BLOCK_SIZE * z);
-                // f64 noise = get_noise(
-                //     blockPosition.x,
-                //     blockPosition.y,
-                //     blockPosition.z, 0.05, 2.0, 0.25, ctx);
-                // bool exists = noise > 0.1 ? false : true;
-                bool exists = true;
-
-                /* bool exists = (rand() % 20) > 10 ? true : false; */
-                /* if (z == CHUNK_SIZE-1 && (x == 0 || x == 1 || x == 3 || x == 2)) */
-                /*     exists = true; */
-                /* else */
-                /*     exists = false; */
-                this->chunks[chunkX][chunkY][chunkZ].blocks[x][y][z].exists = exists;
-
-                if (exists)
-                {
-                    num_blocks++;
-                }
-            }
-        }
+        any |= new_voxels[w];
+        all &= new_voxels[w];
+        this->num_blocks += um::popcount(new_voxels[w]);
     }
-    // for (i32 i = CHUNK_SIZE-1; i >= 0; i--)
-    // {
-    //     this->chunks[chunkX][chunkY][chunkZ].blocks[i][CHUNK_SIZE-1][CHUNK_SIZE-1].exists = false;
-    //     num_blocks--;
-    // }
 
-    this->chunks[chunkX][chunkY][chunkZ].num_blocks = num_blocks;
+    if (any == 0 || all == ~0ull)
+    {
+        this->fill = (any == 0) ? CHUNK_EMPTY : CHUNK_SOLID;
+        return;
+    }
 
-    open_simplex_noise_free(ctx);
+    allocate_voxels(*this);
+    memcpy(this->voxels, new_voxels, sizeof(u64) * VOXEL_LAYOUT_WORDS);
+    this->fill = CHUNK_MIXED;
 
-    //@Performance: This two functions can possibly be merged into one if performance is needed.
-    create_chunk_vertex_buffer(chunk);
-    //NOTE(leo): at the moment this function is not necessary. First it is best to try to render
-    // the triangles for each chunk into the depth buffer.
-    create_chunk_occluders(chunk);
+    u32 columns[CHUNK_SIZE][CHUNK_SIZE];
+    ChunkLayout::load_columns(this->voxels, columns);
+    build_mips(columns);
 }
 
-//@TEMP(leo): this function should be temporary.
-static glm::vec3 buf[vx::FACE_COUNT * 6]; // Each occluder has 6 vertices
 void
-render_chunk_occluders(const vx::Chunk& chunk)
+vx::ChunkStorage::get_columns(u32 out[CHUNK_SIZE][CHUNK_SIZE]) const
 {
-    memset(buf, 0, sizeof(buf));
-    u32 v = 0;
+    if (this->fill != CHUNK_MIXED)
     {
-        Quad3* occ = chunk.occluders[vx::FACE_RIGHT];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p1;
-        }
-        else
-        {
-            // OCC IS NULL
-        }
+        memset(out, this->fill == CHUNK_SOLID ? 0xFF : 0x00, sizeof(u32) * CHUNK_SIZE * CHUNK_SIZE);
+        return;
     }
+    ChunkLayout::load_columns(this->voxels, out);
+}
+
+void
+vx::ChunkStorage::expand()
+{
+    ASSERT(this->fill != CHUNK_MIXED);
+    allocate_voxels(*this);
+    u32 columns[CHUNK_SIZE][CHUNK_SIZE];
+    get_columns(columns);
+    memset(this->voxels, this->fill == CHUNK_SOLID ? 0xFF : 0x00, sizeof(u64) * VOXEL_LAYOUT_WORDS);
+    build_mips(columns);
+    this->fill = CHUNK_MIXED;
+}
+
+// Halves a column along y, each bit of the result is set if either of its two bits was.
+u32
+halve_column(u32 column)
+{
+    u32 bits = (column | (column >> 1)) & 0x55555555;
+    bits = (bits | (bits >> 1)) & 0x33333333;
+    bits = (bits | (bits >> 2)) & 0x0F0F0F0F;
+    bits = (bits | (bits >> 4)) & 0x00FF00FF;
+    bits = (bits | (bits >> 8)) & 0x0000FFFF;
+    return bits;
+}
+
+void
+vx::ChunkStorage::build_mips(const u32 columns[CHUNK_SIZE][CHUNK_SIZE])
+{
+    // Each level is built from the one below it, every cell merging 2x2 columns of 2 cells.
+    vx::ChunkMips& mips = *this->mips;
+    for (i32 x = 0; x < 16; x++)
+        for (i32 z = 0; z < 16; z++)
+            mips.level1[x][z] = halve_column(columns[2*x][2*z] | columns[2*x+1][2*z] |
+                                             columns[2*x][2*z+1] | columns[2*x+1][2*z+1]);
+    for (i32 x = 0; x < 8; x++)
+        for (i32 z = 0; z < 8; z++)
+            mips.level2[x][z] = halve_column(mips.level1[2*x][2*z] | mips.level1[2*x+1][2*z] |
+                                             mips.level1[2*x][2*z+1] | mips.level1[2*x+1][2*z+1]);
+    for (i32 x = 0; x < 4; x++)
+        for (i32 z = 0; z < 4; z++)
+            mips.level3[x][z] = halve_column(mips.level2[2*x][2*z] | mips.level2[2*x+1][2*z] |
+                                             mips.level2[2*x][2*z+1] | mips.level2[2*x+1][2*z+1]);
+    for (i32 x = 0; x < 2; x++)
+        for (i32 z = 0; z < 2; z++)
+            mips.level4[x][z] = halve_column(mips.level3[2*x][2*z] | mips.level3[2*x+1][2*z] |
+                                             mips.level3[2*x][2*z+1] | mips.level3[2*x+1][2*z+1]);
+    mips.level5 = halve_column(mips.level4[0][0] | mips.level4[1][0] | mips.level4[0][1] | mips.level4[1][1]);
+}
+
+// Sets bit y of a mip column, returns false if it already had that value.
+template<typename T>
+bool
+set_mip_bit(T& column, i32 y, bool value)
+{
+    const T old = column;
+    if (value)
+        column |= (T)(1u << y);
+    else
+        column &= (T)~(1u << y);
+    return column != old;
+}
+
+void
+vx::ChunkStorage::update_mips(i32 x, i32 y, i32 z)
+{
+    ASSERT(this->fill == CHUNK_MIXED);
+    vx::ChunkMips& mips = *this->mips;
+    for (u32 level = 1; level < CHUNK_MIP_LEVELS; level++)
     {
-        Quad3* occ = chunk.occluders[vx::FACE_LEFT];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p1;
-        }
-        else
+        x /= 2; y /= 2; z /= 2;
+        const u32 children = mip_column(level-1, 2*x, 2*z) | mip_column(level-1, 2*x+1, 2*z) |
+                             mip_column(level-1, 2*x, 2*z+1) | mip_column(level-1, 2*x+1, 2*z+1);
+        const bool value = (children >> (2*y)) & 3;
+
+        bool changed = false;
+        switch (level)
         {
-            /* printf("OCC NULL\n"); */
+        case 1: changed = set_mip_bit(mips.level1[x][z], y, value); break;
+        case 2: changed = set_mip_bit(mips.level2[x][z], y, value); break;
+        case 3: changed = set_mip_bit(mips.level3[x][z], y, value); break;
+        case 4: changed = set_mip_bit(mips.level4[x][z], y, value); break;
+        case 5: changed = set_mip_bit(mips.level5, y, value); break;
         }
+        // Coarser levels only depend on this cell, so they did not change either.
+        if (!changed) break;
     }
+}
+
+u32
+vx::ChunkStorage::mip_column(u32 level, i32 x, i32 z) const
+{
+    ASSERT(level < CHUNK_MIP_LEVELS);
+    if (this->fill != CHUNK_MIXED)
     {
-        Quad3* occ = chunk.occluders[vx::FACE_UP];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p1;
-        }
-        else
-        {
-            /* printf("OCC NULL\n"); */
-        }
+        if (this->fill == CHUNK_EMPTY) return 0;
+        return level == 0 ? ~0u : (1u << (CHUNK_SIZE >> level)) - 1;
     }
+
+    switch (level)
     {
-        Quad3* occ = chunk.occluders[vx::FACE_DOWN];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p1;
-        }
-        else
-        {
-            /* printf("OCC NULL\n"); */
-        }
+    case 0: return ChunkLayout::column(this->voxels, x, z);
+    case 1: return this->mips->level1[x][z];
+    case 2: return this->mips->level2[x][z];
+    case 3: return this->mips->level3[x][z];
+    case 4: return this->mips->level4[x][z];
+    default: return this->mips->level5;
     }
-    {
-        Quad3* occ = chunk.occluders[vx::FACE_FRONT];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p1;
-        }
-        else
+}
+
+// Tests the cells of a level that overlap the box, going down into the occupied ones until
+// the blocks are reached.
+bool
+mip_region_empty(const vx::ChunkStorage& storage, u32 level,
+                 i32 min_x, i32 min_y, i32 min_z, i32 max_x, i32 max_y, i32 max_z)
+{
+    const i32 min_cy = min_y >> level;
+    const i32 max_cy = max_y >> level;
+    const u32 y_mask = ((2u << max_cy) - 1) & ~((1u << min_cy) - 1);
+
+    for (i32 cx = min_x >> level; cx <= (max_x >> level); cx++)
+        for (i32 cz = min_z >> level; cz <= (max_z >> level); cz++)
         {
-            /* printf("OCC NULL\n"); */
+            for (u32 hits = storage.mip_column(level, cx, cz) & y_mask; hits != 0; hits &= hits - 1)
+            {
+                if (level == 0) return false;
+
+                const i32 cy = um::count_trailing_zeros(hits);
+                const i32 size = 1 << level;
+                if (!mip_region_empty(storage, level - 1,
+                                      MAX(min_x, cx * size), MAX(min_y, cy * size), MAX(min_z, cz * size),
+                                      MIN(max_x, cx * size + size - 1), MIN(max_y, cy * size + size - 1),
+                                      MIN(max_z, cz * size + size - 1)))
+                {
+                    return false;
+                }
+            }
         }
-    }
+    return true;
+}
+
+bool
+vx::ChunkStorage::region_empty(i32 min_x, i32 min_y, i32 min_z, i32 max_x, i32 max_y, i32 max_z) const
+{
+    ASSERT(min_x >= 0 && min_y >= 0 && min_z >= 0);
+    ASSERT(max_x < CHUNK_SIZE && max_y < CHUNK_SIZE && max_z < CHUNK_SIZE);
+    ASSERT(min_x <= max_x && min_y <= max_y && min_z <= max_z);
+    if (this->fill != CHUNK_MIXED)
+        return this->fill == CHUNK_EMPTY;
+
+    // Start at the finest level where the box covers at most 2 cells per axis, so empty
+    // space is usually rejected after testing a handful of cells.
+    u32 level = 0;
+    while (level+1 < CHUNK_MIP_LEVELS &&
+           ((max_x >> level) - (min_x >> level) > 1 ||
+            (max_y >> level) - (min_y >> level) > 1 ||
+            (max_z >> level) - (min_z >> level) > 1))
     {
-        Quad3* occ = chunk.occluders[vx::FACE_BACK];
-        if (occ != NULL)
-        {
-            buf[v++] = occ->p1;
-            buf[v++] = occ->p4;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p2;
-            buf[v++] = occ->p3;
-            buf[v++] = occ->p1;
-        }
-        else
-        {
-            /* printf("OCC NULL\n"); */
-        }
+        level++;
     }
+    return mip_region_empty(*this, level, min_x, min_y, min_z, max_x, max_y, max_z);
+}
 
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+void
+vx::ChunkStorage::clear()
+{
+    this->num_blocks = 0;
+    this->fill = CHUNK_EMPTY;
+    this->types.clear();
+}
 
-    glBindVertexArray(vao);
+vx::ChunkStorage*
+vx::ChunkStorage::create()
+{
+    vx::ChunkStorage* storage = (vx::ChunkStorage*)calloc(1, sizeof(vx::ChunkStorage));
+    ASSERT(storage != NULL);
+    storage->refcount = 1;
+    return storage;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3f) * v, buf, GL_STATIC_DRAW);
+vx::ChunkStorage*
+vx::ChunkStorage::clone() const
+{
+    vx::ChunkStorage* copy = create();
+    copy->num_blocks = this->num_blocks;
+    copy->fill = this->fill;
+    if (this->fill == CHUNK_MIXED)
+    {
+        allocate_voxels(*copy);
+        memcpy(copy->voxels, this->voxels, sizeof(u64) * VOXEL_LAYOUT_WORDS);
+        memcpy(copy->mips, this->mips, sizeof(vx::ChunkMips));
+    }
+    copy->types.copy(this->types);
+    return copy;
+}
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+void
+vx::ChunkStorage::retain()
+{
+    um::atomic_increment(&this->refcount);
+}
 
-    /* glDisable(GL_CULL_FACE); */
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    /* glEnable(GL_CULL_FACE); */
+void
+vx::ChunkStorage::release()
+{
+    if (um::atomic_decrement(&this->refcount) > 0) return;
 
-    glBindVertexArray(0);
+    free(this->voxels);
+    free(this->mips);
+    this->types.destroy();
+    free(this);
 }
 
 void
-vx::ChunkManager::render_occluders(const vx::Camera& camera, const vx::Memory& mem, const bool* keyboard) const
+vx::ChunkSnapshot::release()
 {
-    UNUSED(mem);
-    UNUSED(keyboard);
-
-    glm::mat4 view = camera.view_matrix();
-    GLuint viewLoc;
-    GLuint ambientColorLoc, diffuseColorLoc, specularColorLoc, shininessLoc;
-    GLuint cameraPositionLoc, lightPositionLoc, lightColorLoc;
-    vx::Material material;
+    // Snapshots never write, the const is only dropped to drop the reference.
+    const_cast<vx::ChunkStorage*>(this->storage)->release();
+    this->storage = nullptr;
+}
 
-    for (u32 i = 0; i < WORLD_SIZE; i++)
-        for (u32 j = 0; j < WORLD_SIZE; j++)
-            for (u32 k = 0; k < WORLD_SIZE; k++)
-            {
-                if (this->chunks[i][j][k].num_blocks == 0) continue;
-                // -----------------
-                // Frustum Culling
-                // -----------------
-                bool chunkInsideFrustum = camera.frustum.chunk_inside(this->chunks[i][j][k]);
-                if (!chunkInsideFrustum) continue;
-
-                // =====================================================
-                //                Chunk is Visible
-                // ======================================================
-
-                vx::Shader* shader = this->chunks[i][j][k].shader;
-
-                glUseProgram(shader->program);
-                // Transform matrices locations
-                viewLoc           = shader->uniform_location("view");
-                // Material uniform locations
-                ambientColorLoc   = shader->uniform_location("material.ambientColor");
-                diffuseColorLoc   = shader->uniform_location("material.diffuseColor");
-                specularColorLoc  = shader->uniform_location("material.specularColor");
-                shininessLoc      = shader->uniform_location("material.shininess");
-                // Light position and color and camera position
-                cameraPositionLoc = shader->uniform_location("cameraPosition");
-                lightPositionLoc  = shader->uniform_location("light.position");
-                lightColorLoc     = shader->uniform_location("light.color");
-                // Sets the corresponding uniforms.
-                // Transforms
-                glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-                // Materials
-                material = this->chunks[i][j][k].material;
-                glUniform3f(ambientColorLoc, 1.0f, 0.0f, 0.0f);
-                glUniform3f(diffuseColorLoc, 1.0f, 0.0f, 0.0f);
-                glUniform3f(specularColorLoc,
-                            material.specularColor.x,
-                            material.specularColor.y,
-                            material.specularColor.z);
-                glUniform1f(shininessLoc, material.shininess);
-                // Light and Camera
-                glUniform3f(cameraPositionLoc,
-                            camera.frustum.position.x,
-                            camera.frustum.position.y,
-                            camera.frustum.position.z);
-
-                glUniform3f(lightPositionLoc, 50.0f, 100.0f, 50.0f);
-                glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f); // white color
-                // ===========================
-                //          Render
-                // ===========================
-                render_chunk_occluders(this->chunks[i][j][k]);
-
-                glBindVertexArray(0);
-                glUseProgram(0);
+vx::ChunkStorage*
+vx::Chunk::writable_storage()
+{
+    // Only the owner of the chunk takes snapshots, so if the count reads one nobody else can
+    // get a reference in the meantime. Reading more than one while a snapshot is being
+    // released only costs a copy that was not needed.
+    if (um::atomic_load(&this->storage->refcount) > 1)
+    {
+        vx::ChunkStorage* copy = this->storage->clone();
+        this->storage->release();
+        this->storage = copy;
+    }
+    return this->storage;
+}
 
-            }
-    /* END_TIMED_BLOCK(DebugCycleCount_RenderChunks); */
+void
+vx::Chunk::set_blocks(const vx::BlockType* new_types)
+{
+    if (um::atomic_load(&this->storage->refcount) > 1)
+    {
+        this->storage->release();
+        this->storage = vx::ChunkStorage::create();
+    }
+    this->storage->set_blocks(new_types);
 }
 
 void
-vx::ChunkManager::render_chunks(const Frustum& frustum, const glm::mat4& view,
-                                const Memory& mem, const bool* keyboard) const
+vx::Chunk::set_columns(const u32 new_columns[CHUNK_SIZE][CHUNK_SIZE])
 {
-    UNUSED(mem);
-    UNUSED(keyboard);
-    /* BEGIN_TIMED_BLOCK(DebugCycleCount_RenderChunks); */
+    if (um::atomic_load(&this->storage->refcount) > 1)
+    {
+        this->storage->release();
+        this->storage = vx::ChunkStorage::create();
+    }
+    this->storage->set_columns(new_columns);
+}
 
-    GLuint view_loc;
-    GLuint ambient_color_loc, diffuse_color_loc, specular_color_loc, shininess_loc;
-    GLuint camera_position_loc, light_position_loc, light_color_loc;
-    vx::Material material;
+vx::ChunkSnapshot
+vx::Chunk::snapshot() const
+{
+    this->storage->retain();
 
-    for (u32 i = 0; i < WORLD_SIZE; i++)
-        for (u32 j = 0; j < WORLD_SIZE; j++)
-            for (u32 k = 0; k < WORLD_SIZE; k++)
-            {
+    vx::ChunkSnapshot snapshot;
+    snapshot.storage = this->storage;
+    snapshot.coord = this->coord;
+    snapshot.position = this->position;
+    return snapshot;
+}
 
-                // =========================================================
-                // Verify if the chunk needs to be rendered or not.
-                // Steps:
-                //   1. Verify if chunk has blocks
-                //   2. Apply frustum culling
-                //   3. TODO: Apply occlusion culling
-                //          * Implement a depth buffer renderer
-                // =========================================================
-                if (this->chunks[i][j][k].num_blocks == 0) continue;
-                // -----------------
-                // Frustum Culling
-                // -----------------
-                bool chunkInsideFrustum = frustum.chunk_inside(this->chunks[i][j][k]);
-                if (!chunkInsideFrustum) continue;
-                // -----------------
-                // Occlusion Culling
-                // -----------------
-                // TODO: For each of the chunks on the world, find its occluders.
-                // TODO: After the occluders are found, render them on the depth buffer
-                // using the scanline algorithm.
-
-
-                // =====================================================
-                //                Chunk is Visible
-                // ======================================================
-
-                vx::Shader* shader = this->chunks[i][j][k].shader;
-
-                glUseProgram(shader->program);
-                // Transform matrices locations
-                view_loc            = shader->uniform_location("view");
-                // Material uniform locations
-                ambient_color_loc   = shader->uniform_location("material.ambientColor");
-                diffuse_color_loc   = shader->uniform_location("material.diffuseColor");
-                specular_color_loc  = shader->uniform_location("material.specularColor");
-                shininess_loc       = shader->uniform_location("material.shininess");
-                // Light position and color and camera position
-                camera_position_loc = shader->uniform_location("cameraPosition");
-                light_position_loc  = shader->uniform_location("light.position");
-                light_color_loc     = shader->uniform_location("light.color");
-                // Sets the corresponding uniforms.
-                // Transforms
-                glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view));
-                // Materials
-                material = this->chunks[i][j][k].material;
-                glUniform3f(ambient_color_loc,
-                            material.ambientColor.x,
-                            material.ambientColor.y,
-                            material.ambientColor.z);
-                glUniform3f(diffuse_color_loc,
-                            material.diffuseColor.x,
-                            material.diffuseColor.y,
-                            material.diffuseColor.z);
-                glUniform3f(specular_color_loc,
-                            material.specularColor.x,
-                            material.specularColor.y,
-                            material.specularColor.z);
-                glUniform1f(shininess_loc, material.shininess);
-                // Light and Camera
-                glUniform3f(camera_position_loc, frustum.position.x, frustum.position.y, frustum.position.z);
-
-                f64 time = glfwGetTime();
-                glm::vec3 lightPosition;
-                lightPosition.x = sinf(time) * 50.0f;
-                lightPosition.y = 300.0f;
-                lightPosition.z = cosf(time) * 50.0f;
-                /* vec3_Print(lightPosition); */
-                /* glUniform3f(lightPositionLoc, lightPosition.x, lightPosition.y, lightPosition.z); */
-                glUniform3f(light_position_loc, 50.0f, 100.0f, 50.0f);
-                glUniform3f(light_color_loc, 1.0f, 1.0f, 1.0f); // white color
-                // ===========================
-                //          Render
-                // ===========================
-                glBindVertexArray(this->chunks[i][j][k].vao);
-
-                glDrawArrays(GL_TRIANGLES, 0, this->chunks[i][j][k].num_vertices);
-
-                glBindVertexArray(0);
+vx::ChunkPool::ChunkPool()
+    : pages(nullptr)
+    , num_pages(0)
+    , free_slots(nullptr)
+    , num_free(0)
+{
+}
 
-            }
-    /* END_TIMED_BLOCK(DebugCycleCount_RenderChunks); */
+vx::ChunkPool::~ChunkPool()
+{
+    for (u32 i = 0; i < this->num_pages * PAGE_SIZE; i++)
+    {
+        vx::Chunk& chunk = slot(i);
+        if (chunk.storage)
+            chunk.storage->release();
+        free(chunk.mesh.vertices);
+    }
+    for (u32 i = 0; i < this->num_pages; i++)
+        free(this->pages[i]);
+    free(this->pages);
+    free(this->free_slots);
 }
 
-void
-vx::ChunkManager::render_chunks_wireframe(const glm::mat4& view, const Shader* shader) const
+vx::Chunk*
+vx::ChunkPool::acquire()
 {
-    GLuint view_loc = shader->uniform_location("view");
-    glUseProgram(shader->program);
-    glUniformMatrix4fv(view_loc, 1, GL_FALSE, glm::value_ptr(view));
+    if (this->num_free == 0)
+    {
+        const u32 first_slot = this->num_pages * PAGE_SIZE;
+        this->num_pages++;
+        this->pages = (vx::Chunk**)realloc(this->pages, sizeof(vx::Chunk*) * this->num_pages);
+        this->free_slots = (u32*)realloc(this->free_slots, sizeof(u32) * this->num_pages * PAGE_SIZE);
+        ASSERT(this->pages != NULL && this->free_slots != NULL);
+
+        vx::Chunk* page = (vx::Chunk*)calloc(PAGE_SIZE, sizeof(vx::Chunk));
+        ASSERT(page != NULL);
+        this->pages[this->num_pages-1] = page;
+
+        // Pushed in reverse, so the slots are handed out in order.
+        for (u32 i = PAGE_SIZE; i-- > 0;)
+        {
+            page[i].slot = first_slot + i;
+            // Starts at one so a zeroed handle is never valid.
+            page[i].generation = 1;
+            this->free_slots[this->num_free++] = first_slot + i;
+        }
+    }
 
-    for (u32 i = 0; i < WORLD_SIZE; i++)
-        for (u32 j = 0; j < WORLD_SIZE; j++)
-            for (u32 k = 0; k < WORLD_SIZE; k++)
-            {
-                // Render
-                // ===========================
-                glBindVertexArray(this->chunks[i][j][k].vao);
-                glDrawArrays(GL_TRIANGLES, 0, this->chunks[i][j][k].num_vertices);
-                glBindVertexArray(0);
-            }
+    vx::Chunk& chunk = slot(this->free_slots[--this->num_free]);
+    if (chunk.storage == nullptr)
+        chunk.storage = vx::ChunkStorage::create();
+    ASSERT(chunk.storage->fill == CHUNK_EMPTY && chunk.storage->num_blocks == 0);
+    memset(&chunk.dirty, 0, sizeof(chunk.dirty));
+    return &chunk;
 }
 
 void
-create_chunk_vertex_buffer(vx::Chunk& chunk)
+vx::ChunkPool::release(vx::Chunk* chunk)
 {
-    using vec3 = glm::vec3;
-    /*
-      TODO: @Cleanup
-
-      This code can be heavily decreased in line size, since there is a lot of
-      code repetition.
-    */
-    static const u64 SIZE = ((sizeof(vec3) * 2 * 8) * vx::CHUNK_SIZE * vx::CHUNK_SIZE * vx::CHUNK_SIZE);
-    static vec3 vertices[SIZE];
-    static bool face[vx::CHUNK_SIZE][vx::CHUNK_SIZE];
-
-    /* ===============================================================
-     *
-     *                       BACK FACES
-     *
-     * =============================================================== */
-    u64 v = 0;
-    for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+    ASSERT(&slot(chunk->slot) == chunk);
+    chunk->generation++;
+    // The storage is only kept for the next chunk if no snapshot is still reading it.
+    if (um::atomic_load(&chunk->storage->refcount) == 1)
+    {
+        chunk->storage->clear();
+    }
+    else
     {
-        memset(face, 0, sizeof(face));
+        chunk->storage->release();
+        chunk->storage = nullptr;
+    }
+    this->free_slots[this->num_free++] = chunk->slot;
+}
 
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
-        {
-            // Iterate faster through the x coord
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
-            {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[x][y] == true ||
-                    (z > 0 && chunk.blocks[x][y][z-1].exists))
-                {
-                    face[x][y] = true; //NOTE: maybe not necessary
-                    continue;
-                }
+vx::Chunk*
+vx::ChunkPool::get(vx::ChunkHandle handle) const
+{
+    if (handle.slot >= this->num_pages * PAGE_SIZE) return nullptr;
 
-                const i32 quadBeginX = x;
-                face[quadBeginX][y] = true;
+    vx::Chunk& chunk = slot(handle.slot);
+    if (chunk.generation != handle.generation) return nullptr;
+    return &chunk;
+}
 
-                i32 quadEndX = x;
-                while (quadEndX+1 < vx::CHUNK_SIZE &&
-                       (z == 0 || !chunk.blocks[quadEndX+1][y][z-1].exists) &&
-                       chunk.blocks[quadEndX+1][y][z].exists &&
-                       face[quadEndX+1][y] == false)
-                {
-                    quadEndX++;
-                    face[quadEndX][y] = true;
-                }
+vx::ChunkManager::ChunkManager(vx::StreamBuffer* stream)
+    : chunks(nullptr)
+    , render_infos(nullptr)
+    , occluders(nullptr)
+    , num_chunks(0)
+    , chunks_capacity(0)
+    , num_materials(0)
+    , num_shaders(0)
+    , position(0.0f, 0.0f, 0.0f)
+    , vertex_pages(INITIAL_VERTEX_BUFFER_SIZE / VERTEX_PAGE_SIZE)
+    , stream(stream)
+    , dirty_chunks(nullptr)
+    , num_dirty(0)
+    , dirty_capacity(0)
+{
+    // One core is left to the render thread.
+    const long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    this->builder = new vx::ChunkBuilder(num_cores > 2 ? (u32)num_cores - 1 : 1);
+
+    u32* indices = (u32*)malloc(sizeof(u32) * MAX_CHUNK_QUADS * QUAD_INDICES);
+    ASSERT(indices != NULL);
+    vx::build_quad_indices(indices, MAX_CHUNK_QUADS);
+
+    glGenVertexArrays(1, &this->vao);
+    glGenBuffers(1, &this->vertex_buffer);
+    glGenVertexArrays(1, &this->occluders_vao);
+    glBindVertexArray(this->occluders_vao);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glGenBuffers(1, &this->quad_indices);
 
-                const i32 quadBeginY = y;
-                i32 quadEndY = y;
-                while (quadEndY+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[quadBeginX][quadEndY+1][z].exists &&
-                       (z == 0 || !chunk.blocks[quadBeginX][quadEndY+1][z-1].exists) &&
-                       face[quadBeginX][quadEndY+1] == false)
-                {
-                    for (i32 qi = quadBeginX; qi <= quadEndX; qi++)
-                    {
-                        if (chunk.blocks[qi][quadEndY+1][z].exists &&
-                            (z == 0 || !chunk.blocks[qi][quadEndY+1][z-1].exists) &&
-                            face[qi][quadEndY+1] == false)
-                            continue;
-                        else
-                            goto EndBackFaceLoop;
-                    }
-                    quadEndY++;
-                }
-            EndBackFaceLoop:
-                // Remove back face from blocks
-                for (i32 qy = quadBeginY; qy <= quadEndY; qy++)
-                    for (i32 qx = quadBeginX; qx <= quadEndX; qx++)
-                        face[qx][qy] = true;
-
-                // TODO: Add this to the vertices list to be added to VBO
-                // quadBeginX, quadEndX, quadBeginY, quadEndY
-                vec3 leftBottom;
-                leftBottom.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                leftBottom.z = chunk.position.z + (z * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                leftTop.z = chunk.position.z + (z * vx::BLOCK_SIZE);
-                vec3 rightBottom;
-                rightBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                rightBottom.z = chunk.position.z + (z * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                rightTop.z = chunk.position.z + (z * vx::BLOCK_SIZE);
-
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, -1.0f);
-            }
-        }
-    }
-    /* ===============================================================
-     *
-     *                       FRONT FACES
-     *
-     * =============================================================== */
-    for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vx::ChunkVertex) * INITIAL_VERTEX_BUFFER_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &this->chunk_origins);
+    glBindBuffer(GL_TEXTURE_BUFFER, this->chunk_origins);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * this->vertex_pages.capacity(), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &this->chunk_origins_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, this->chunk_origins_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->chunk_origins);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    memset(&this->draw_list, 0, sizeof(this->draw_list));
+
+    // The element array binding is part of the vertex array, it never changes.
+    glBindVertexArray(this->vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->quad_indices);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * MAX_CHUNK_QUADS * QUAD_INDICES, indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(indices);
+
+    set_chunk_vertex_format(*this);
+}
+
+vx::ChunkManager::~ChunkManager()
+{
+    // Stopped first, the chunks of the jobs in flight go back to the pool.
+    this->builder->stop();
+    while (vx::ChunkBuildJob* job = this->builder->finished())
+    {
+        if (job->kind == vx::JOB_REMESH)
+            end_remesh(*this, *job, false);
+        else
+            this->pool.release(job->chunk);
+        this->builder->release_job(job);
+    }
+    delete this->builder;
+    while (this->num_chunks > 0)
     {
-        memset(face, 0, sizeof(face));
+        const vx::ChunkCoord& coord = this->chunks[this->num_chunks-1]->coord;
+        destroy_chunk(coord.x, coord.y, coord.z);
+    }
+    free(this->chunks);
+    free(this->render_infos);
+    free(this->occluders);
+    free(this->dirty_chunks);
+    glDeleteBuffers(1, &this->quad_indices);
+    glDeleteBuffers(1, &this->vertex_buffer);
+    glDeleteVertexArrays(1, &this->vao);
+    glDeleteVertexArrays(1, &this->occluders_vao);
+    glDeleteTextures(1, &this->chunk_origins_texture);
+    glDeleteBuffers(1, &this->chunk_origins);
+    free(this->draw_list.items);
+    free(this->draw_list.counts);
+    free(this->draw_list.offsets);
+    free(this->draw_list.base_vertices);
+}
 
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
-        {
-            // Iterate faster through the x coord
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
-            {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[x][y] == true ||
-                    (z < vx::CHUNK_SIZE-1 && chunk.blocks[x][y][z+1].exists))
-                {
-                    face[x][y] = true; //NOTE: maybe not necessary
-                    continue;
-                }
+u32
+vx::ChunkManager::add_material(const vx::Material& material)
+{
+    ASSERT(this->num_materials < MAX_MATERIALS);
+    this->materials[this->num_materials] = material;
+    return this->num_materials++;
+}
 
-                const i32 quadBeginX = x;
-                face[quadBeginX][y] = true;
+vx::ChunkHandle
+vx::ChunkManager::chunk_handle(i32 x, i32 y, i32 z) const
+{
+    u32 index = this->map.get(vx::ChunkCoord(x, y, z));
+    if (index == vx::ChunkMap::INVALID) return vx::ChunkHandle{0, 0};
+    return this->chunks[index]->handle();
+}
 
-                i32 quadEndX = x;
-                while (quadEndX+1 < vx::CHUNK_SIZE &&
-                       (z == vx::CHUNK_SIZE-1 || !chunk.blocks[quadEndX+1][y][z+1].exists) &&
-                       chunk.blocks[quadEndX+1][y][z].exists &&
-                       face[quadEndX+1][y] == false)
-                {
-                    quadEndX++;
-                    face[quadEndX][y] = true;
-                }
+vx::Chunk*
+vx::ChunkManager::chunk(vx::ChunkHandle handle) const
+{
+    return this->pool.get(handle);
+}
 
-                const i32 quadBeginY = y;
-                i32 quadEndY = y;
-                while (quadEndY+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[quadBeginX][quadEndY+1][z].exists &&
-                       (z == vx::CHUNK_SIZE-1 || !chunk.blocks[quadBeginX][quadEndY+1][z+1].exists) &&
-                       face[quadBeginX][quadEndY+1] == false)
+// Offset to the neighbouring chunk on the side of each face.
+static const vx::ChunkCoord FACE_NEIGHBOURS[vx::FACE_COUNT] =
+{
+    vx::ChunkCoord( 0,  0, -1), // FACE_BACK
+    vx::ChunkCoord( 0,  0,  1), // FACE_FRONT
+    vx::ChunkCoord( 1,  0,  0), // FACE_RIGHT
+    vx::ChunkCoord(-1,  0,  0), // FACE_LEFT
+    vx::ChunkCoord( 0,  1,  0), // FACE_UP
+    vx::ChunkCoord( 0, -1,  0), // FACE_DOWN
+};
+
+void
+vx::ChunkManager::chunk_borders(vx::ChunkCoord coord, vx::ChunkBorders& borders) const
+{
+    for (u32 face = 0; face < FACE_COUNT; face++)
+    {
+        u32* slice = borders.slices[face];
+        const vx::ChunkCoord& offset = FACE_NEIGHBOURS[face];
+        u32 index = this->map.get(vx::ChunkCoord(coord.x + offset.x, coord.y + offset.y, coord.z + offset.z));
+        if (index == vx::ChunkMap::INVALID)
+        {
+            memset(slice, 0, sizeof(u32) * CHUNK_SIZE);
+            continue;
+        }
+
+        const vx::Chunk& neighbour = *this->chunks[index];
+        switch (face)
+        {
+            case FACE_BACK:
+                for (i32 x = 0; x < CHUNK_SIZE; x++) slice[x] = neighbour.column(x, CHUNK_SIZE-1);
+                break;
+            case FACE_FRONT:
+                for (i32 x = 0; x < CHUNK_SIZE; x++) slice[x] = neighbour.column(x, 0);
+                break;
+            case FACE_RIGHT:
+                for (i32 z = 0; z < CHUNK_SIZE; z++) slice[z] = neighbour.column(0, z);
+                break;
+            case FACE_LEFT:
+                for (i32 z = 0; z < CHUNK_SIZE; z++) slice[z] = neighbour.column(CHUNK_SIZE-1, z);
+                break;
+            case FACE_UP:
+            case FACE_DOWN:
+            {
+                // The bottom layer of the chunk above, or the top layer of the one below.
+                const u32 shift = (face == FACE_UP) ? 0 : CHUNK_SIZE-1;
+                for (i32 x = 0; x < CHUNK_SIZE; x++)
                 {
-                    for (i32 qi = quadBeginX; qi <= quadEndX; qi++)
-                    {
-                        if (chunk.blocks[qi][quadEndY+1][z].exists &&
-                            (z == vx::CHUNK_SIZE-1 || !chunk.blocks[qi][quadEndY+1][z+1].exists) &&
-                            face[qi][quadEndY+1] == false)
-                            continue;
-                        else
-                            goto EndLoopFrontFace;
-                    }
-                    quadEndY++;
+                    u32 row = 0;
+                    for (i32 z = 0; z < CHUNK_SIZE; z++)
+                        row |= ((neighbour.column(x, z) >> shift) & 1) << z;
+                    slice[x] = row;
                 }
-            EndLoopFrontFace:
-                // Remove back face from blocks
-                for (i32 qy = quadBeginY; qy <= quadEndY; qy++)
-                    for (i32 qx = quadBeginX; qx <= quadEndX; qx++)
-                        face[qx][qy] = true;
-
-                vec3 leftBottom;
-                leftBottom.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                leftBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (z * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                leftTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (z * vx::BLOCK_SIZE);
-                vec3 rightBottom;
-                rightBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                rightBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (z * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                rightTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (z * vx::BLOCK_SIZE);
-
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, 0.0f, 1.0f);
+                break;
             }
         }
     }
-    /* ===============================================================
-     *
-     *                       LEFT FACES
-     *
-     * =============================================================== */
-    for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+}
+
+void
+vx::ChunkManager::update_neighbour_borders(vx::ChunkCoord coord)
+{
+    for (u32 face = 0; face < FACE_COUNT; face++)
     {
-        memset(face, 0, sizeof(face));
+        const vx::ChunkCoord& offset = FACE_NEIGHBOURS[face];
+        vx::ChunkCoord neighbour_coord(coord.x + offset.x, coord.y + offset.y, coord.z + offset.z);
+        u32 index = this->map.get(neighbour_coord);
+        if (index == vx::ChunkMap::INVALID) continue;
+
+        // Only the border of the neighbour that faces the chunk.
+        const u32 neighbour_face = face ^ 1;
+        vx::ChunkDirtySlices dirty = {};
+        dirty.masks[neighbour_face] = 1u << FACE_BORDER_SLICES[neighbour_face];
+        mark_dirty(index, dirty);
+    }
+}
 
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
-        {
-            // Iterate faster through the x coord
-            for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
-            {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[z][y] == true ||
-                    (x > 0 && chunk.blocks[x-1][y][z].exists))
-                {
-                    face[z][y] = true; //NOTE: maybe not necessary
-                    continue;
-                }
+void
+vx::ChunkManager::mark_dirty(u32 index, const vx::ChunkDirtySlices& dirty)
+{
+    vx::Chunk& chunk = *this->chunks[index];
+    bool was_clean = true;
+    bool is_clean = true;
+    for (u32 face = 0; face < FACE_COUNT; face++)
+    {
+        was_clean &= chunk.dirty.masks[face] == 0;
+        chunk.dirty.masks[face] |= dirty.masks[face];
+        is_clean &= chunk.dirty.masks[face] == 0;
+    }
+    // Chunks are only listed once, when they get their first dirty slice.
+    if (!was_clean || is_clean) return;
 
-                const i32 quadBeginZ = z;
-                face[quadBeginZ][y] = true;
+    if (this->num_dirty == this->dirty_capacity)
+    {
+        this->dirty_capacity = MAX(16, this->dirty_capacity * 2);
+        this->dirty_chunks = (vx::ChunkCoord*)realloc(this->dirty_chunks, sizeof(vx::ChunkCoord) * this->dirty_capacity);
+        ASSERT(this->dirty_chunks != NULL);
+    }
+    this->dirty_chunks[this->num_dirty++] = chunk.coord;
+}
 
-                i32 quadEndZ = z;
-                while (quadEndZ+1 < vx::CHUNK_SIZE &&
-                       (x == 0 || !chunk.blocks[x-1][y][quadEndZ+1].exists) &&
-                       chunk.blocks[x][y][quadEndZ+1].exists &&
-                       face[quadEndZ+1][y] == false)
-                {
-                    quadEndZ++;
-                    face[quadEndZ][y] = true;
-                }
+// Adds an empty chunk at coord for a block that is placed there, drawn like its first loaded
+// neighbour, or with the first chunk shader and material if it has none. Its mesh is empty
+// and matches its empty columns, so the dirty slices of the block are enough to mesh it.
+u32
+add_placed_chunk(vx::ChunkManager& manager, vx::ChunkCoord coord)
+{
+    using namespace vx;
+    ASSERT(manager.num_shaders > 0 && manager.num_materials > 0);
+    u32 shader = 0;
+    u32 material = 0;
+    for (u32 face = 0; face < FACE_COUNT; face++)
+    {
+        const vx::ChunkCoord& offset = FACE_NEIGHBOURS[face];
+        const u32 neighbour = manager.map.get(vx::ChunkCoord(coord.x + offset.x, coord.y + offset.y, coord.z + offset.z));
+        if (neighbour == vx::ChunkMap::INVALID) continue;
+        shader = manager.render_infos[neighbour].shader;
+        material = manager.render_infos[neighbour].material;
+        break;
+    }
 
-                const i32 quadBeginY = y;
-                i32 quadEndY = y;
-                while (quadEndY+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[x][quadEndY+1][quadBeginZ].exists &&
-                       (x == 0 || !chunk.blocks[x-1][quadEndY+1][quadBeginZ].exists) &&
-                       face[quadBeginZ][quadEndY+1] == false)
-                {
-                    for (i32 qk = quadBeginZ; qk <= quadEndZ; qk++)
-                    {
-                        if (chunk.blocks[x][quadEndY+1][qk].exists &&
-                            (x == 0 || !chunk.blocks[x-1][quadEndY+1][qk].exists) &&
-                            face[qk][quadEndY+1] == false)
-                            continue;
-                        else
-                            goto EndLoopLeftFace;
-                    }
-                    quadEndY++;
-                }
-            EndLoopLeftFace:
-                // Remove back face from blocks
-                for (i32 qy = quadBeginY; qy <= quadEndY; qy++)
-                    for (i32 qz = quadBeginZ; qz <= quadEndZ; qz++)
-                        face[qz][qy] = true;
-
-                vec3 leftBottom;
-                leftBottom.x = chunk.position.x + (x * vx::BLOCK_SIZE);
-                leftBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                leftBottom.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = chunk.position.x + (x * vx::BLOCK_SIZE);
-                leftTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                leftTop.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 rightBottom;
-                rightBottom.x = chunk.position.x + (x * vx::BLOCK_SIZE);
-                rightBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                rightBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = chunk.position.x + (x * vx::BLOCK_SIZE);
-                rightTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                rightTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(-1.0f, 0.0f, 0.0f);
-            }
-        }
+    vx::Chunk& chunk = acquire_chunk(manager, coord);
+    vx::ChunkVertex* kept_vertices = chunk.mesh.vertices;
+    const u32 kept_capacity = chunk.mesh.capacity;
+    memset(&chunk.mesh, 0, sizeof(chunk.mesh));
+    chunk.mesh.vertices = kept_vertices;
+    chunk.mesh.capacity = kept_capacity;
+    chunk.mesh.mode = MESH_FAST;
+    chunk.first_vertex = 0;
+    return add_chunk(manager, chunk, shader, material);
+}
+
+void
+vx::ChunkManager::set_block(i32 x, i32 y, i32 z, vx::BlockType type)
+{
+    // Arithmetic shifts round towards negative infinity, so negative coordinates work too.
+    const vx::ChunkCoord coord(x >> CHUNK_SIZE_LOG2, y >> CHUNK_SIZE_LOG2, z >> CHUNK_SIZE_LOG2);
+    u32 index = this->map.get(coord);
+    if (index == vx::ChunkMap::INVALID)
+    {
+        // Chunks without blocks are not stored, their blocks are all air already.
+        if (type == BLOCK_AIR) return;
+        index = add_placed_chunk(*this, coord);
     }
-    /* ===============================================================
-     *
-     *                       RIGHT FACES
-     *
-     * =============================================================== */
-    for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+
+    const i32 local[3] = { x & (CHUNK_SIZE-1), y & (CHUNK_SIZE-1), z & (CHUNK_SIZE-1) };
+    vx::Chunk& chunk = *this->chunks[index];
+    if (chunk.block_type(local[0], local[1], local[2]) == type) return;
+    // Changing the type of a block that stays solid does not change the mesh yet.
+    const bool changes_mesh = chunk.block(local[0], local[1], local[2]) != (type != BLOCK_AIR);
+    chunk.set_block(local[0], local[1], local[2], type);
+    if (!changes_mesh) return;
+
+    vx::ChunkDirtySlices dirty = {};
+    vx::mark_dirty_block(dirty, local[0], local[1], local[2]);
+    mark_dirty(index, dirty);
+
+    // A block on a border hides or shows the border faces of the neighbour.
+    static constexpr u32 FACE_AXIS[FACE_COUNT] = { 2, 2, 0, 0, 1, 1 };
+    for (u32 face = 0; face < FACE_COUNT; face++)
     {
-        memset(face, 0, sizeof(face));
+        if ((u32)local[FACE_AXIS[face]] != FACE_BORDER_SLICES[face]) continue;
 
-        for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
+        const vx::ChunkCoord& offset = FACE_NEIGHBOURS[face];
+        const u32 neighbour = this->map.get(vx::ChunkCoord(coord.x + offset.x, coord.y + offset.y, coord.z + offset.z));
+        if (neighbour == vx::ChunkMap::INVALID) continue;
+
+        const u32 neighbour_face = face ^ 1;
+        vx::ChunkDirtySlices neighbour_dirty = {};
+        neighbour_dirty.masks[neighbour_face] = 1u << FACE_BORDER_SLICES[neighbour_face];
+        mark_dirty(neighbour, neighbour_dirty);
+    }
+}
+
+void
+vx::ChunkManager::update_dirty_meshes()
+{
+    // Chunks still being remeshed are kept in the list. Destroying a chunk marks its
+    // neighbours, which may add to the list while it is walked.
+    u32 num_kept = 0;
+    for (u32 i = 0; i < this->num_dirty; i++)
+    {
+        const vx::ChunkCoord coord = this->dirty_chunks[i];
+        const u32 index = this->map.get(coord);
+        if (index == vx::ChunkMap::INVALID) continue;
+
+        vx::Chunk& chunk = *this->chunks[index];
+        if (chunk.remeshing)
         {
-            // Iterate faster through the x coord
-            for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
-            {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[z][y] == true ||
-                    (x < vx::CHUNK_SIZE-1 && chunk.blocks[x+1][y][z].exists))
-                {
-                    face[z][y] = true; //NOTE: maybe not necessary
-                    continue;
-                }
+            this->dirty_chunks[num_kept++] = coord;
+            continue;
+        }
+        const vx::ChunkDirtySlices dirty = chunk.dirty;
+        memset(&chunk.dirty, 0, sizeof(chunk.dirty));
+
+        if (chunk.storage->num_blocks == 0)
+        {
+            // The last block was removed.
+            destroy_chunk(coord.x, coord.y, coord.z);
+            continue;
+        }
 
-                const i32 quadBeginZ = z;
-                face[quadBeginZ][y] = true;
+        u32 num_dirty_slices = 0;
+        for (u32 face = 0; face < FACE_COUNT; face++)
+            num_dirty_slices += um::popcount(dirty.masks[face]);
+        if (num_dirty_slices == 0) continue;
 
-                i32 quadEndZ = z;
-                while (quadEndZ+1 < vx::CHUNK_SIZE &&
-                       (x == vx::CHUNK_SIZE-1 || !chunk.blocks[x+1][y][quadEndZ+1].exists) &&
-                       chunk.blocks[x][y][quadEndZ+1].exists &&
-                       face[quadEndZ+1][y] == false)
-                {
-                    quadEndZ++;
-                    face[quadEndZ][y] = true;
-                }
+        vx::ChunkBorders borders;
+        chunk_borders(coord, borders);
 
-                const i32 quadBeginY = y;
-                i32 quadEndY = y;
-                while (quadEndY+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[x][quadEndY+1][quadBeginZ].exists &&
-                       (x == vx::CHUNK_SIZE-1 || !chunk.blocks[x+1][quadEndY+1][quadBeginZ].exists) &&
-                       face[quadBeginZ][quadEndY+1] == false)
-                {
-                    for (i32 qk = quadBeginZ; qk <= quadEndZ; qk++)
-                    {
-                        if (chunk.blocks[x][quadEndY+1][qk].exists &&
-                            (x == vx::CHUNK_SIZE-1 ||
-                             !chunk.blocks[x+1][quadEndY+1][qk].exists) &&
-                            face[qk][quadEndY+1] == false)
-                            continue;
-                        else
-                            goto EndLoopRightFace;
-                    }
-                    quadEndY++;
-                }
-            EndLoopRightFace:
-                // Remove back face from blocks
-                for (i32 qy = quadBeginY; qy <= quadEndY; qy++)
-                    for (i32 qz = quadBeginZ; qz <= quadEndZ; qz++)
-                        face[qz][qy] = true;
-
-                vec3 rightBottom;
-                rightBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (x * vx::BLOCK_SIZE);
-                rightBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                rightBottom.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (x * vx::BLOCK_SIZE);
-                rightTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                rightTop.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 leftBottom;
-                leftBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (x * vx::BLOCK_SIZE);
-                leftBottom.y = chunk.position.y + (quadBeginY * vx::BLOCK_SIZE);
-                leftBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (x * vx::BLOCK_SIZE);
-                leftTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (quadEndY * vx::BLOCK_SIZE);
-                leftTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(1.0f, 0.0f, 0.0f);
+        vx::ChunkBuildJob* job = this->builder->acquire_job();
+        if (job != nullptr)
+        {
+            job->kind = vx::JOB_REMESH;
+            job->borders = borders;
+            job->snapshot = chunk.snapshot();
+            job->handle = chunk.handle();
+            job->dirty = dirty;
+            job->old_mesh = chunk.mesh;
+            if (this->builder->submit(job))
+            {
+                chunk.remeshing = true;
+                continue;
             }
+            job->snapshot.release();
+            this->builder->release_job(job);
+        }
+
+        // The builder is busy, e.g. loading chunks, so the edit does not wait for it.
+        u32 columns[CHUNK_SIZE][CHUNK_SIZE];
+        chunk.get_columns(columns);
+        vx::ChunkMesh& mesh = vx::scratch_mesh();
+        u32 first_changed = 0;
+        u32 changed_end;
+        if (num_dirty_slices > vx::MAX_DIRTY_SLICES)
+        {
+            vx::build_chunk_mesh(columns, borders, mesh, chunk.mesh.mode);
+            changed_end = mesh.num_vertices;
+        }
+        else
+        {
+            first_changed = vx::update_chunk_mesh(columns, borders, dirty, chunk.mesh, mesh, changed_end);
         }
+        upload_chunk_mesh(*this, chunk, mesh, first_changed, changed_end, this->render_infos[index]);
+        vx::build_chunk_occluders(columns, chunk.position, this->occluders[index]);
+    }
+    this->num_dirty = num_kept;
+}
+
+bool
+vx::ChunkManager::block(i32 x, i32 y, i32 z) const
+{
+    // Arithmetic shifts round towards negative infinity, so negative coordinates work too.
+    u32 index = this->map.get(vx::ChunkCoord(x >> CHUNK_SIZE_LOG2, y >> CHUNK_SIZE_LOG2, z >> CHUNK_SIZE_LOG2));
+    if (index == vx::ChunkMap::INVALID) return false;
+    return this->chunks[index]->block(x & (CHUNK_SIZE-1), y & (CHUNK_SIZE-1), z & (CHUNK_SIZE-1));
+}
+
+void
+vx::ChunkManager::destroy_chunk(i32 x, i32 y, i32 z)
+{
+    vx::ChunkCoord coord(x, y, z);
+    u32 index = this->map.get(coord);
+    if (index == vx::ChunkMap::INVALID) return;
+
+    // The range of the mesh goes back to the vertex buffer. The chunk keeps the vertices of
+    // its copy, the next chunk created in its slot reuses them.
+    vx::Chunk& chunk = *this->chunks[index];
+    if (chunk.remeshing)
+    {
+        // The remesh job still reads the vertices, they are left to it.
+        chunk.mesh.vertices = nullptr;
+        chunk.mesh.capacity = 0;
+        chunk.remeshing = false;
     }
-    /* ===============================================================
-     *
-     *                       BOTTOM FACES
-     *
-     * =============================================================== */
-    for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
+    if (chunk.reserved_vertices > 0)
+        this->vertex_pages.free(chunk.first_vertex / VERTEX_PAGE_SIZE, chunk.reserved_vertices / VERTEX_PAGE_SIZE);
+    chunk.reserved_vertices = 0;
+    chunk.mesh.num_vertices = 0;
+    this->pool.release(&chunk);
+
+    // Swap the last chunk into the hole to keep the lists dense.
+    this->map.remove(coord);
+    this->num_chunks--;
+    if (index != this->num_chunks)
     {
-        memset(face, 0, sizeof(face));
+        this->chunks[index] = this->chunks[this->num_chunks];
+        this->render_infos[index] = this->render_infos[this->num_chunks];
+        this->occluders[index] = this->occluders[this->num_chunks];
+        this->map.set(this->chunks[index]->coord, index);
+    }
+
+    // The faces that the chunk was hiding are visible again.
+    update_neighbour_borders(coord);
+}
 
-        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+// Acquires a chunk from the pool for coord, with no blocks and no mesh.
+vx::Chunk&
+acquire_chunk(vx::ChunkManager& manager, vx::ChunkCoord coord)
+{
+    using namespace vx;
+    vx::Chunk& chunk = *manager.pool.acquire();
+
+    // Set the world position of the chunks relative to the world position of the manager itself.
+    glm::vec3 position = manager.position;
+    position.x += coord.x * CHUNK_SIZE * BLOCK_SIZE;
+    position.y += coord.y * CHUNK_SIZE * BLOCK_SIZE;
+    position.z += coord.z * CHUNK_SIZE * BLOCK_SIZE;
+
+    chunk.coord = coord;
+    chunk.position = position;
+    return chunk;
+}
+
+// Acquires the chunk of a build job and sets everything but its blocks and mesh.
+void
+init_build_job(vx::ChunkManager& manager, vx::ChunkBuildJob& job, i32 chunkX, i32 chunkY, i32 chunkZ,
+               vx::Shader* shader, u32 material, vx::ChunkMeshMode mesh_mode)
+{
+    using namespace vx;
+    ASSERT(manager.map.get(vx::ChunkCoord(chunkX, chunkY, chunkZ)) == vx::ChunkMap::INVALID);
+    ASSERT(material < manager.num_materials);
+
+    // The chunk is only added to the manager once it is built, if it has any blocks.
+    vx::Chunk& chunk = acquire_chunk(manager, vx::ChunkCoord(chunkX, chunkY, chunkZ));
+
+    job.kind = vx::JOB_BUILD;
+    job.chunk = &chunk;
+    job.shader = shader;
+    job.material = material;
+    job.mesh_mode = mesh_mode;
+    manager.chunk_borders(chunk.coord, job.borders);
+}
+
+vx::ChunkHandle
+vx::ChunkManager::create_chunk(i32 chunkX, i32 chunkY, i32 chunkZ, vx::Shader* shader, u32 material,
+                               vx::ChunkMeshMode mesh_mode)
+{
+    vx::ChunkBuildJob job;
+    init_build_job(*this, job, chunkX, chunkY, chunkZ, shader, material, mesh_mode);
+    vx::build_chunk(job);
+    return add_built_chunk(job);
+}
+
+bool
+vx::ChunkManager::request_chunk(i32 chunkX, i32 chunkY, i32 chunkZ, vx::Shader* shader, u32 material,
+                                vx::ChunkMeshMode mesh_mode)
+{
+    vx::ChunkBuildJob* job = this->builder->acquire_job();
+    if (job == nullptr) return false;
+
+    init_build_job(*this, *job, chunkX, chunkY, chunkZ, shader, material, mesh_mode);
+    if (!this->builder->submit(job))
+    {
+        this->pool.release(job->chunk);
+        this->builder->release_job(job);
+        return false;
+    }
+    return true;
+}
+
+u32
+vx::ChunkManager::upload_built_chunks(u32 max_chunks)
+{
+    u32 n = 0;
+    while (n < max_chunks)
+    {
+        vx::ChunkBuildJob* job = this->builder->finished();
+        if (job == nullptr) break;
+
+        // Remeshes are small and an edit is waiting for them, they do not count.
+        if (job->kind == vx::JOB_REMESH)
         {
-            // Iterate faster through the x coord
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
-            {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[x][z] == true ||
-                    (y > 0 && chunk.blocks[x][y-1][z].exists))
-                {
-                    face[x][z] = true; //NOTE: maybe not necessary
-                    continue;
-                }
+            end_remesh(*this, *job, true);
+        }
+        // The same chunk may have been created while the job was built.
+        else if (this->map.get(job->chunk->coord) != vx::ChunkMap::INVALID)
+        {
+            this->pool.release(job->chunk);
+            n++;
+        }
+        else
+        {
+            add_built_chunk(*job);
+            n++;
+        }
+        this->builder->release_job(job);
+    }
+    return n;
+}
 
-                const i32 quadBeginX = x;
-                face[quadBeginX][z] = true;
+// Uploads the mesh and occluders of a finished remesh job if upload is set and its chunk was
+// not destroyed meanwhile, then releases its snapshot. Jobs that stop took back unbuilt have
+// to come with upload unset.
+void
+end_remesh(vx::ChunkManager& manager, vx::ChunkBuildJob& job, bool upload)
+{
+    vx::Chunk* chunk = manager.pool.get(job.handle);
+    if (chunk == nullptr)
+    {
+        // destroy_chunk left the vertices of the old mesh to the job.
+        free(job.old_mesh.vertices);
+    }
+    else
+    {
+        ASSERT(chunk->remeshing && chunk->mesh.vertices == job.old_mesh.vertices);
+        chunk->remeshing = false;
+        if (upload)
+        {
+            const u32 index = manager.map.get(chunk->coord);
+            upload_chunk_mesh(manager, *chunk, job.mesh, job.first_changed, job.changed_end,
+                              manager.render_infos[index]);
+            manager.occluders[index] = job.occluders;
+        }
+    }
+    job.snapshot.release();
+}
 
-                i32 quadEndX = x;
-                while (quadEndX+1 < vx::CHUNK_SIZE &&
-                       (y == 0 || !chunk.blocks[quadEndX+1][y-1][z].exists) &&
-                       chunk.blocks[quadEndX+1][y][z].exists &&
-                       face[quadEndX+1][z] == false)
-                {
-                    quadEndX++;
-                    face[quadEndX][z] = true;
-                }
+// Returns the index of shader in the chunk shaders of the manager, adding it the first time.
+u32
+chunk_shader_index(vx::ChunkManager& manager, vx::Shader* shader)
+{
+    for (u32 i = 0; i < manager.num_shaders; i++)
+        if (manager.shaders[i].shader == shader) return i;
+
+    ASSERT(manager.num_shaders < vx::MAX_CHUNK_SHADERS);
+    vx::ChunkShader& chunk_shader = manager.shaders[manager.num_shaders];
+    memset(&chunk_shader, 0, sizeof(chunk_shader));
+    chunk_shader.shader = shader;
+    return manager.num_shaders++;
+}
 
-                const i32 quadBeginZ = z;
-                i32 quadEndZ = z;
-                while (quadEndZ+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[quadBeginX][y][quadEndZ+1].exists &&
-                       (y == 0 || !chunk.blocks[quadBeginX][y-1][quadEndZ+1].exists) &&
-                       face[quadBeginX][quadEndZ+1] == false)
-                {
-                    for (i32 qi = quadBeginX; qi <= quadEndX; qi++)
-                    {
-                        if (chunk.blocks[qi][y][quadEndZ+1].exists &&
-                            (y == 0 || !chunk.blocks[qi][y-1][quadEndZ+1].exists) &&
-                            face[qi][quadEndZ+1] == false)
-                            continue;
-                        else
-                            goto EndLoopBottomFace;
-                    }
-                    quadEndZ++;
-                }
-            EndLoopBottomFace:
-                // Remove face from blocks
-                for (i32 qz = quadBeginZ; qz <= quadEndZ; qz++)
-                    for (i32 qx = quadBeginX; qx <= quadEndX; qx++)
-                        face[qx][qz] = true;
-
-                vec3 rightBottom;
-                rightBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightBottom.y = chunk.position.y + (y * vx::BLOCK_SIZE);
-                rightBottom.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightTop.y = chunk.position.y + (y * vx::BLOCK_SIZE);
-                rightTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-                vec3 leftBottom;
-                leftBottom.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftBottom.y = chunk.position.y + (y * vx::BLOCK_SIZE);
-                leftBottom.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftTop.y = chunk.position.y + (y * vx::BLOCK_SIZE);
-                leftTop.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, -1.0f, 0.0f);
-            }
+// Appends the chunk to the dense lists of the manager and returns its index. Its render info
+// is left without vertices and its occluders without quads.
+u32
+add_chunk(vx::ChunkManager& manager, vx::Chunk& chunk, u32 shader, u32 material)
+{
+    using namespace vx;
+    if (manager.num_chunks == manager.chunks_capacity)
+    {
+        manager.chunks_capacity = MAX(16, manager.chunks_capacity * 2);
+        manager.chunks = (vx::Chunk**)realloc(manager.chunks, sizeof(vx::Chunk*) * manager.chunks_capacity);
+        manager.render_infos = (vx::ChunkRenderInfo*)realloc(
+            manager.render_infos, sizeof(vx::ChunkRenderInfo) * manager.chunks_capacity);
+        manager.occluders = (vx::ChunkOccluders*)realloc(
+            manager.occluders, sizeof(vx::ChunkOccluders) * manager.chunks_capacity);
+        ASSERT(manager.chunks != NULL && manager.render_infos != NULL && manager.occluders != NULL);
+    }
+    const u32 index = manager.num_chunks++;
+    manager.chunks[index] = &chunk;
+    manager.map.insert(chunk.coord, index);
+
+    vx::ChunkRenderInfo& info = manager.render_infos[index];
+    memset(&info, 0, sizeof(info));
+    info.aabb_min = chunk.position;
+    info.aabb_max = chunk.position + glm::vec3(BLOCK_SIZE * CHUNK_SIZE);
+    info.shader = shader;
+    info.material = material;
+    memset(&manager.occluders[index], 0, sizeof(manager.occluders[index]));
+    return index;
+}
+
+vx::ChunkHandle
+vx::ChunkManager::add_built_chunk(vx::ChunkBuildJob& job)
+{
+    vx::Chunk& chunk = *job.chunk;
+
+    if (chunk.storage->fill == CHUNK_EMPTY)
+    {
+        // Empty chunks are not stored, they would not render anything anyway.
+        this->pool.release(&chunk);
+        return vx::ChunkHandle{0, 0};
+    }
+
+    const u32 index = add_chunk(*this, chunk, chunk_shader_index(*this, job.shader), job.material);
+    vx::ChunkRenderInfo& info = this->render_infos[index];
+    upload_chunk_mesh(*this, chunk, chunk.mesh, 0, chunk.mesh.num_vertices, info);
+    //NOTE(leo): at the moment the occluders are not necessary. First it is best to try to render
+    // the triangles for each chunk into the depth buffer.
+    this->occluders[index] = job.occluders;
+
+    // Neighbours created or destroyed while the job was built change the border faces.
+    vx::ChunkBorders borders;
+    chunk_borders(chunk.coord, borders);
+    vx::ChunkDirtySlices dirty = {};
+    for (u32 face = 0; face < FACE_COUNT; face++)
+    {
+        if (memcmp(borders.slices[face], job.borders.slices[face], sizeof(borders.slices[face])) != 0)
+            dirty.masks[face] = 1u << FACE_BORDER_SLICES[face];
+    }
+    mark_dirty(index, dirty);
+
+    // The neighbours do not need the faces that the new chunk hides anymore.
+    update_neighbour_borders(chunk.coord);
+
+    return chunk.handle();
+}
+
+//@TEMP(leo): this function should be temporary.
+static glm::vec3 buf[vx::FACE_COUNT * 6]; // Each occluder has 6 vertices
+void
+render_chunk_occluders(const vx::ChunkOccluders& occluders, vx::StreamBuffer& stream)
+{
+    memset(buf, 0, sizeof(buf));
+    u32 v = 0;
+    {
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_RIGHT)) ? &occluders.quads[vx::FACE_RIGHT] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            // OCC IS NULL
+        }
+    }
+    {
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_LEFT)) ? &occluders.quads[vx::FACE_LEFT] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            /* printf("OCC NULL\n"); */
+        }
+    }
+    {
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_UP)) ? &occluders.quads[vx::FACE_UP] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            /* printf("OCC NULL\n"); */
+        }
+    }
+    {
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_DOWN)) ? &occluders.quads[vx::FACE_DOWN] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            /* printf("OCC NULL\n"); */
         }
     }
-    /* ===============================================================
-     *
-     *                       TOP FACES
-     *
-     * =============================================================== */
-    for (i32 y = 0; y < vx::CHUNK_SIZE; y++)
     {
-        memset(face, 0, sizeof(face));
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_FRONT)) ? &occluders.quads[vx::FACE_FRONT] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            /* printf("OCC NULL\n"); */
+        }
+    }
+    {
+        const Quad3* occ = (occluders.mask & (1u << vx::FACE_BACK)) ? &occluders.quads[vx::FACE_BACK] : NULL;
+        if (occ != NULL)
+        {
+            buf[v++] = occ->p1;
+            buf[v++] = occ->p4;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p2;
+            buf[v++] = occ->p3;
+            buf[v++] = occ->p1;
+        }
+        else
+        {
+            /* printf("OCC NULL\n"); */
+        }
+    }
+
+    if (v == 0) return;
+
+    // Drawn with the occluders vertex array of the manager, which reads the stream buffer.
+    const u32 offset = stream.write(buf, sizeof(glm::vec3) * v, sizeof(glm::vec3));
+    /* glDisable(GL_CULL_FACE); */
+    glDrawArrays(GL_TRIANGLES, offset / sizeof(glm::vec3), v);
+    /* glEnable(GL_CULL_FACE); */
+}
+
+void
+vx::ChunkManager::render_occluders(const vx::Camera& camera, const vx::Shader* shader, vx::StreamBuffer& stream) const
+{
+    // The occluders are already in world space, the program only needs the frame uniforms.
+    glUseProgram(shader->program);
+
+    // The buffer of the stream never changes, but the vertex array may not have seen it yet.
+    glBindVertexArray(this->occluders_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (u32 i = 0; i < this->num_chunks; i++)
+    {
+        const vx::ChunkRenderInfo& info = this->render_infos[i];
+        if (info.num_vertices == 0) continue;
+        if (!camera.frustum.chunk_inside(info)) continue;
+        render_chunk_occluders(this->occluders[i], stream);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+// True if some face of the direction inside the chunk can be seen from the camera, i.e. the
+// camera is in front of the first plane a face of that direction can be on.
+bool
+face_can_be_visible(const vx::ChunkRenderInfo& info, vx::Face face, glm::vec3 camera)
+{
+    switch (face)
+    {
+        case vx::FACE_BACK:  return camera.z < info.aabb_max.z - vx::BLOCK_SIZE;
+        case vx::FACE_FRONT: return camera.z > info.aabb_min.z + vx::BLOCK_SIZE;
+        case vx::FACE_RIGHT: return camera.x > info.aabb_min.x + vx::BLOCK_SIZE;
+        case vx::FACE_LEFT:  return camera.x < info.aabb_max.x - vx::BLOCK_SIZE;
+        case vx::FACE_UP:    return camera.y > info.aabb_min.y + vx::BLOCK_SIZE;
+        case vx::FACE_DOWN:  return camera.y < info.aabb_max.y - vx::BLOCK_SIZE;
+        default: return true;
+    }
+}
 
-        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+// Adds the ranges of the face directions of the chunk that can face the camera to the draw
+// list from range on, returns how many were added. Ranges that follow each other in the vertex
+// buffer are merged, so a chunk adds 2 * FACE_COUNT ranges at most.
+u32
+add_chunk_faces(const vx::ChunkRenderInfo& info, glm::vec3 camera, vx::ChunkDrawList& list, u32 range)
+{
+    bool visible[vx::FACE_COUNT];
+    for (u32 face = 0; face < vx::FACE_COUNT; face++)
+        visible[face] = face_can_be_visible(info, (vx::Face)face, camera);
+
+    const u32 first_range = range;
+    u32 first = 0;
+    bool extend = false;
+    for (u32 part = 0; part < vx::MESH_PART_COUNT; part++)
+    {
+        for (u32 face = 0; face < vx::FACE_COUNT; face++)
         {
-            // Iterate faster through the x coord
-            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+            const u32 count = info.face_vertices[part][face];
+            if (count == 0) continue;
+            if (!visible[face])
             {
-                if (!chunk.blocks[x][y][z].exists ||
-                    face[x][z] == true ||
-                    (y < vx::CHUNK_SIZE-1 && chunk.blocks[x][y+1][z].exists))
-                {
-                    face[x][z] = true; //NOTE: maybe not necessary
-                    continue;
-                }
-
-                const i32 quadBeginX = x;
-                face[quadBeginX][z] = true;
+                extend = false;
+                first += count;
+                continue;
+            }
 
-                i32 quadEndX = x;
-                while (quadEndX+1 < vx::CHUNK_SIZE &&
-                       (y == vx::CHUNK_SIZE-1 || !chunk.blocks[quadEndX+1][y+1][z].exists) &&
-                       chunk.blocks[quadEndX+1][y][z].exists &&
-                       face[quadEndX+1][z] == false)
-                {
-                    quadEndX++;
-                    face[quadEndX][z] = true;
-                }
-                const i32 quadBeginZ = z;
-                i32 quadEndZ = z;
-                while (quadEndZ+1 < vx::CHUNK_SIZE &&
-                       chunk.blocks[quadBeginX][y][quadEndZ+1].exists &&
-                       (y == vx::CHUNK_SIZE-1 || !chunk.blocks[quadBeginX][y+1][quadEndZ+1].exists) &&
-                       face[quadBeginX][quadEndZ+1] == false)
-                {
-                    for (i32 qi = quadBeginX; qi <= quadEndX; qi++)
-                    {
-                        if (chunk.blocks[qi][y][quadEndZ+1].exists &&
-                            (y == vx::CHUNK_SIZE-1 || !chunk.blocks[qi][y+1][quadEndZ+1].exists) &&
-                            face[qi][quadEndZ+1] == false)
-                            continue;
-                        else
-                            goto EndLoopTopFace;
-                    }
-                    quadEndZ++;
-                }
-            EndLoopTopFace:
-                // Remove face from blocks
-                for (i32 qz = quadBeginZ; qz <= quadEndZ; qz++)
-                    for (i32 qx = quadBeginX; qx <= quadEndX; qx++)
-                        face[qx][qz] = true;
-
-                vec3 rightBottom;
-                rightBottom.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightBottom.y = (chunk.position.y + vx::BLOCK_SIZE) + (y * vx::BLOCK_SIZE);
-                rightBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-                vec3 rightTop;
-                rightTop.x = (chunk.position.x + vx::BLOCK_SIZE) + (quadEndX * vx::BLOCK_SIZE);
-                rightTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (y * vx::BLOCK_SIZE);
-                rightTop.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-                vec3 leftBottom;
-                leftBottom.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftBottom.y = (chunk.position.y + vx::BLOCK_SIZE) + (y * vx::BLOCK_SIZE);
-                leftBottom.z = (chunk.position.z + vx::BLOCK_SIZE) + (quadEndZ * vx::BLOCK_SIZE);
-                vec3 leftTop;
-                leftTop.x = chunk.position.x + (quadBeginX * vx::BLOCK_SIZE);
-                leftTop.y = (chunk.position.y + vx::BLOCK_SIZE) + (y * vx::BLOCK_SIZE);
-                leftTop.z = chunk.position.z + (quadBeginZ * vx::BLOCK_SIZE);
-
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
-                vertices[v++] = rightTop;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
-                vertices[v++] = leftTop;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
-                vertices[v++] = leftBottom;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
-                vertices[v++] = rightBottom;
-                vertices[v++] = vec3(0.0f, 1.0f, 0.0f);
+            // Vertex counts are whole quads, each drawn with QUAD_INDICES indices.
+            const GLsizei num_indices = count / 4 * vx::QUAD_INDICES;
+            if (extend)
+            {
+                list.counts[range-1] += num_indices;
+            }
+            else
+            {
+                list.counts[range] = num_indices;
+                list.offsets[range] = (const GLvoid*)(sizeof(u32) * (first / 4 * vx::QUAD_INDICES));
+                list.base_vertices[range] = info.first_vertex;
+                range++;
+                extend = true;
             }
+            first += count;
         }
     }
-    chunk.num_vertices = v;
+    return range - first_range;
+}
 
-    glGenVertexArrays(1, &chunk.vao);
-    glGenBuffers(1, &chunk.vbo);
+// Makes room in the draw list for the ranges of num_chunks chunks.
+void
+reserve_draw_list(vx::ChunkDrawList& list, u32 num_chunks)
+{
+    if (num_chunks <= list.items_capacity) return;
+
+    list.items_capacity = MAX(64, num_chunks + num_chunks / 2);
+    const u32 num_ranges = list.items_capacity * 2 * vx::FACE_COUNT;
+    list.items = (u64*)realloc(list.items, sizeof(u64) * list.items_capacity);
+    list.counts = (GLsizei*)realloc(list.counts, sizeof(GLsizei) * num_ranges);
+    list.offsets = (const GLvoid**)realloc(list.offsets, sizeof(GLvoid*) * num_ranges);
+    list.base_vertices = (GLint*)realloc(list.base_vertices, sizeof(GLint) * num_ranges);
+    ASSERT(list.items != NULL && list.counts != NULL && list.offsets != NULL && list.base_vertices != NULL);
+}
 
-    glBindVertexArray(chunk.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec3f) * v, vertices, GL_DYNAMIC_DRAW);
-    // Position attribute
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)0);
-    // Normal attribute
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+static_assert(vx::MAX_CHUNK_SHADERS <= 256 && vx::MAX_MATERIALS <= 256, "Eight bits of the draw keys each");
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+// Sort key of the draw item of the chunk at index of the dense lists. From the high bits down:
+// shader, material, distance of the chunk to the camera in blocks and the index, so sorting
+// the keys groups the draws by shader and material and draws each group front to back.
+u64
+chunk_draw_key(const vx::ChunkRenderInfo& info, u32 index, glm::vec3 camera)
+{
+    ASSERT(index <= 0xFFFFFF);
+    const glm::vec3 center = (info.aabb_min + info.aabb_max) * 0.5f;
+    const f32 distance = glm::length(center - camera) / vx::BLOCK_SIZE;
+    const u64 depth = (u64)MIN(distance, (f32)0xFFFFFF);
+    return (u64)info.shader << 56 | (u64)info.material << 48 | depth << 24 | index;
+}
+
+// Binds the program of the chunk shader to read the chunk origins from texture unit 0.
+void
+use_chunk_shader(vx::ChunkShader& chunk_shader)
+{
+    const vx::Shader* shader = chunk_shader.shader;
+    if (!chunk_shader.has_locations)
+    {
+        chunk_shader.chunk_origins  = shader->uniform_location("chunk_origins");
+        chunk_shader.ambient_color  = shader->uniform_location("material.ambientColor");
+        chunk_shader.diffuse_color  = shader->uniform_location("material.diffuseColor");
+        chunk_shader.specular_color = shader->uniform_location("material.specularColor");
+        chunk_shader.shininess      = shader->uniform_location("material.shininess");
+        chunk_shader.has_locations = true;
+    }
+
+    glUseProgram(shader->program);
+    glUniform1i(chunk_shader.chunk_origins, 0);
+}
+
+// Sets the material uniforms of the bound chunk shader.
+void
+set_chunk_material(const vx::ChunkShader& chunk_shader, const vx::Material& material)
+{
+    glUniform3f(chunk_shader.ambient_color,
+                material.ambientColor.x,
+                material.ambientColor.y,
+                material.ambientColor.z);
+    glUniform3f(chunk_shader.diffuse_color,
+                material.diffuseColor.x,
+                material.diffuseColor.y,
+                material.diffuseColor.z);
+    glUniform3f(chunk_shader.specular_color,
+                material.specularColor.x,
+                material.specularColor.y,
+                material.specularColor.z);
+    glUniform1f(chunk_shader.shininess, material.shininess);
+}
+
+// Draws ranges [first_range, end_range) of the draw list with the bound shader and material.
+void
+draw_chunk_ranges(const vx::ChunkDrawList& list, u32 first_range, u32 end_range)
+{
+    if (first_range == end_range) return;
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, list.counts + first_range, GL_UNSIGNED_INT,
+                                  list.offsets + first_range, end_range - first_range,
+                                  list.base_vertices + first_range);
+}
+
+void
+vx::ChunkManager::render_chunks(const Frustum& frustum, const Memory& mem, const bool* keyboard)
+{
+    UNUSED(mem);
+    UNUSED(keyboard);
+    /* BEGIN_TIMED_BLOCK(DebugCycleCount_RenderChunks); */
+
+    vx::ChunkDrawList& list = this->draw_list;
+    reserve_draw_list(list, this->num_chunks);
+    u32 num_items = 0;
+    for (u32 i = 0; i < this->num_chunks; i++)
+    {
+        const vx::ChunkRenderInfo& info = this->render_infos[i];
+
+        // =========================================================
+        // Verify if the chunk needs to be rendered or not.
+        // Steps:
+        //   1. Verify if chunk has any faces
+        //   2. Apply frustum culling
+        //   3. TODO: Apply occlusion culling
+        //          * Implement a depth buffer renderer
+        // =========================================================
+        if (info.num_vertices == 0) continue;
+        // -----------------
+        // Frustum Culling
+        // -----------------
+        bool chunkInsideFrustum = frustum.chunk_inside(info);
+        if (!chunkInsideFrustum) continue;
+        // -----------------
+        // Occlusion Culling
+        // -----------------
+        // TODO: For each of the chunks on the world, find its occluders.
+        // TODO: After the occluders are found, render them on the depth buffer
+        // using the scanline algorithm.
+
+        list.items[num_items++] = chunk_draw_key(info, i, frustum.position);
+    }
+    std::sort(list.items, list.items + num_items);
+
+    // Every chunk draws from the same vertex array, the origins are read from texture unit 0.
+    glBindVertexArray(this->vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, this->chunk_origins_texture);
+
+    // The items come grouped by shader and then by material, so a shader is only bound once
+    // and a material only set once for each shader. Each group is a single draw.
+    u32 shader = vx::MAX_CHUNK_SHADERS;
+    u32 material = vx::MAX_MATERIALS;
+    u32 first_range = 0;
+    u32 num_ranges = 0;
+    for (u32 item = 0; item < num_items; item++)
+    {
+        const u64 key = list.items[item];
+        const u32 item_shader = (u32)(key >> 56);
+        const u32 item_material = (u32)(key >> 48) & 0xFF;
+        if (item_shader != shader || item_material != material)
+        {
+            draw_chunk_ranges(list, first_range, num_ranges);
+            first_range = num_ranges;
+            if (item_shader != shader)
+                use_chunk_shader(this->shaders[item_shader]);
+            set_chunk_material(this->shaders[item_shader], this->materials[item_material]);
+            shader = item_shader;
+            material = item_material;
+        }
+        const vx::ChunkRenderInfo& info = this->render_infos[key & 0xFFFFFF];
+        num_ranges += add_chunk_faces(info, frustum.position, list, num_ranges);
+    }
+    draw_chunk_ranges(list, first_range, num_ranges);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
     glBindVertexArray(0);
+    /* END_TIMED_BLOCK(DebugCycleCount_RenderChunks); */
+}
+
+void
+vx::ChunkManager::render_chunks_wireframe(const Shader* shader)
+{
+    GLuint chunk_origins_loc = shader->uniform_location("chunk_origins");
+    glUseProgram(shader->program);
+    glUniform1i(chunk_origins_loc, 0);
+
+    // The whole mesh of every chunk, in a single call.
+    vx::ChunkDrawList& list = this->draw_list;
+    reserve_draw_list(list, this->num_chunks);
+    GLsizei num_ranges = 0;
+    for (u32 i = 0; i < this->num_chunks; i++)
+    {
+        const vx::ChunkRenderInfo& info = this->render_infos[i];
+        if (info.num_vertices == 0) continue;
+        list.counts[num_ranges] = info.num_vertices / 4 * QUAD_INDICES;
+        list.offsets[num_ranges] = (GLvoid*)0;
+        list.base_vertices[num_ranges] = info.first_vertex;
+        num_ranges++;
+    }
+
+    glBindVertexArray(this->vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, this->chunk_origins_texture);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, list.counts, GL_UNSIGNED_INT, list.offsets, num_ranges,
+                                  list.base_vertices);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void
+set_chunk_vertex_format(const vx::ChunkManager& manager)
+{
+    // The element array binding is part of the vertex array, it is only set when the vertex
+    // array is created and is not touched here.
+    glBindVertexArray(manager.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, manager.vertex_buffer);
+    // Packed vertex, read as an integer and unpacked by the vertex shader.
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(vx::ChunkVertex), (GLvoid*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Replaces buffer by a new one of new_size bytes, with the first size bytes of the old one
+// copied over by the GPU.
+void
+grow_gl_buffer(GLuint& buffer, u32 size, u32 new_size)
+{
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = new_buffer;
+}
+
+// Returns the first of num_pages pages of the vertex buffer of the manager, their origins set
+// to the one of the chunk. When no free range is large enough the vertex buffer and the
+// origins are replaced by buffers twice as large.
+u32
+allocate_chunk_pages(vx::ChunkManager& manager, u32 num_pages, glm::vec3 origin)
+{
+    static constexpr u32 PAGE_SIZE = vx::ChunkManager::VERTEX_PAGE_SIZE;
+
+    u32 first_page = manager.vertex_pages.allocate(num_pages);
+    if (first_page == vx::BufferAllocator::INVALID)
+    {
+        const u32 capacity = manager.vertex_pages.capacity();
+        const u32 new_capacity = MAX(capacity * 2, capacity + num_pages);
+        grow_gl_buffer(manager.vertex_buffer, sizeof(vx::ChunkVertex) * PAGE_SIZE * capacity,
+                       sizeof(vx::ChunkVertex) * PAGE_SIZE * new_capacity);
+        set_chunk_vertex_format(manager);
+        grow_gl_buffer(manager.chunk_origins, sizeof(glm::vec4) * capacity, sizeof(glm::vec4) * new_capacity);
+        glBindTexture(GL_TEXTURE_BUFFER, manager.chunk_origins_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, manager.chunk_origins);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        manager.vertex_pages.grow(new_capacity);
+        first_page = manager.vertex_pages.allocate(num_pages);
+        ASSERT(first_page != vx::BufferAllocator::INVALID);
+    }
+
+    glm::vec4 origins[vx::MAX_CHUNK_MESH_SIZE / PAGE_SIZE + 1];
+    ASSERT(num_pages <= COUNT_OF(origins));
+    for (u32 i = 0; i < num_pages; i++)
+        origins[i] = glm::vec4(origin, 0.0f);
+    // The pages are fresh, written directly rather than through the stream buffer, which is
+    // kept for the small per frame data.
+    glBindBuffer(GL_TEXTURE_BUFFER, manager.chunk_origins);
+    glBufferSubData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * first_page, sizeof(glm::vec4) * num_pages, origins);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return first_page;
+}
+
+// Copies the vertices of mesh between first_changed and changed_end into the mesh kept by the
+// chunk and into its range of the vertex buffer. The vertices outside of that range have to be
+// the same in both already, see update_chunk_mesh. The mesh may be the one of the chunk, when
+// it was built into it.
+void
+upload_chunk_mesh(vx::ChunkManager& manager, vx::Chunk& chunk, const vx::ChunkMesh& mesh, u32 first_changed,
+                  u32 changed_end, vx::ChunkRenderInfo& info)
+{
+    const u32 num_vertices = mesh.num_vertices;
+    ASSERT(first_changed <= changed_end && changed_end <= num_vertices);
+
+    const bool grow = num_vertices > chunk.reserved_vertices;
+    if (grow)
+    {
+        // New chunks get the exact size, up to the end of the page. Edited ones get some room,
+        // since edits tend to come in bursts that add a few faces each. The mesh moves to new
+        // pages.
+        static constexpr u32 PAGE_SIZE = vx::ChunkManager::VERTEX_PAGE_SIZE;
+        const bool is_new = chunk.reserved_vertices == 0;
+        if (!is_new)
+            manager.vertex_pages.free(chunk.first_vertex / PAGE_SIZE, chunk.reserved_vertices / PAGE_SIZE);
+        u32 capacity = is_new ? num_vertices : num_vertices + num_vertices / 4;
+        capacity = MIN(capacity, vx::MAX_CHUNK_MESH_SIZE);
+        const u32 num_pages = (capacity + PAGE_SIZE - 1) / PAGE_SIZE;
+        chunk.reserved_vertices = num_pages * PAGE_SIZE;
+        chunk.first_vertex = allocate_chunk_pages(manager, num_pages, chunk.position) * PAGE_SIZE;
+    }
+    if (&mesh != &chunk.mesh)
+    {
+        if (num_vertices > chunk.mesh.capacity)
+        {
+            chunk.mesh.capacity = chunk.reserved_vertices;
+            chunk.mesh.vertices = (vx::ChunkVertex*)realloc(chunk.mesh.vertices,
+                                                            sizeof(vx::ChunkVertex) * chunk.mesh.capacity);
+            ASSERT(chunk.mesh.vertices != NULL);
+        }
+        memcpy(chunk.mesh.vertices + first_changed, mesh.vertices + first_changed,
+               sizeof(vx::ChunkVertex) * (changed_end - first_changed));
+        vx::ChunkVertex* kept_vertices = chunk.mesh.vertices;
+        const u32 kept_capacity = chunk.mesh.capacity;
+        chunk.mesh = mesh;
+        chunk.mesh.vertices = kept_vertices;
+        chunk.mesh.capacity = kept_capacity;
+    }
+
+    // The whole mesh is uploaded from the copy when it moved. Fresh pages are written directly:
+    // new chunks come in bursts when loading, which would go round the stream buffer and wait
+    // for the draws in the middle of the frame.
+    if (grow)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, manager.vertex_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(vx::ChunkVertex) * chunk.first_vertex,
+                        sizeof(vx::ChunkVertex) * num_vertices, chunk.mesh.vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // An edited chunk is updated in place, in pages the draws of the last frames may still be
+    // reading, so the few vertices that changed go through the stream buffer instead.
+    else if (changed_end > first_changed)
+    {
+        manager.stream->copy(manager.vertex_buffer, sizeof(vx::ChunkVertex) * (chunk.first_vertex + first_changed),
+                             chunk.mesh.vertices + first_changed,
+                             sizeof(vx::ChunkVertex) * (changed_end - first_changed));
+    }
+
+    info.first_vertex = chunk.first_vertex;
+    info.num_vertices = num_vertices;
+    memcpy(info.face_vertices, mesh.face_vertices, sizeof(info.face_vertices));
 }
 
 f64
@@ -7,6 +7,11 @@
 #include "um.hpp"
 #include "vx_math.hpp"
 #include "vx_material.hpp"
+#include "vx_chunk_map.hpp"
+#include "vx_block_palette.hpp"
+#include "vx_voxel_layout.hpp"
+#include "vx_chunk_mesh.hpp"
+#include "vx_buffer_allocator.hpp"
 
 namespace vx
 {
@@ -16,64 +21,420 @@ struct Shader;
 struct Camera;
 struct Memory;
 struct Frustum;
+struct ChunkBuilder;
+struct ChunkBuildJob;
+struct StreamBuffer;
 
-enum Face
+static constexpr u8 BLOCK_SIZE = 1;
+
+// A column holds one bit per block along the y axis, so the chunk size is tied to the word size.
+static_assert(CHUNK_SIZE == 32, "Chunk columns are stored as 32 bit masks");
+static_assert(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE == BlockPalette::LENGTH, "One palette entry per block");
+static_assert(CHUNK_SIZE == VOXEL_LAYOUT_SIZE, "The voxel layouts are written for 32^3 chunks");
+
+// Block types used by the chunk generator.
+static constexpr BlockType BLOCK_GROUND = 1;
+
+static constexpr u32 MAX_MATERIALS = 64;
+static constexpr u32 MAX_CHUNK_SHADERS = 16;
+
+// Chunks where every block has the same value are only tagged with it and store no voxels.
+enum ChunkFill
 {
-    FACE_BACK, FACE_FRONT, FACE_RIGHT, FACE_LEFT, FACE_UP, FACE_DOWN, FACE_COUNT
+    CHUNK_EMPTY, CHUNK_SOLID, CHUNK_MIXED
 };
 
-static constexpr glm::vec3 FACE_NORMALS[6] =
+// Reference to a chunk that is safe to keep around. Once the chunk is destroyed and its pool
+// slot reused the generation does not match anymore, and resolving the handle fails.
+// A zeroed handle never resolves.
+struct ChunkHandle
 {
-    glm::vec3( 0.0f,  0.0f, -1.0f),
-    glm::vec3( 0.0f,  0.0f,  1.0f),
-    glm::vec3( 1.0f,  0.0f,  0.0f),
-    glm::vec3(-1.0f,  0.0f,  0.0f),
-    glm::vec3( 0.0f,  1.0f, -1.0f),
-    glm::vec3( 0.0f, -1.0f, -1.0f),
+    u32                  slot;
+    u32                  generation;
 };
 
-struct Block
+// Occupancy of a chunk at coarser resolutions. Level n has (32 >> n)^3 cells, a cell is set
+// if any block inside it exists. Stored as columns along y like the blocks, i.e. [x][z] with
+// bit y for each cell. Level 0 is the blocks themselves and is not stored here.
+static constexpr u32 CHUNK_MIP_LEVELS = 6;
+
+struct ChunkMips
 {
-    bool exists;
+    u16                  level1[16][16];
+    u8                   level2[8][8];
+    u8                   level3[4][4];
+    u8                   level4[2][2];
+    u8                   level5;
 };
 
-static constexpr u8 WORLD_SIZE = 8;
-static constexpr u8 CHUNK_SIZE = 32;
-static constexpr u8 BLOCK_SIZE = 1;
+// Blocks of a chunk. Shared between the chunk and its snapshots, and only written while the
+// chunk holds the single reference, see Chunk::writable_storage.
+struct ChunkStorage
+{
+    u32                  refcount; // changed atomically, snapshots are released by other threads
+    // Blocks that exist, kept by every function that changes the voxels.
+    u32                  num_blocks;
+    ChunkFill            fill;
+    // Occupancy of the chunk, one bit per block, ordered by ChunkLayout. Only valid for
+    // CHUNK_MIXED chunks. Allocated the first time the chunk is mixed and then kept, so a
+    // recycled storage does not need to allocate it again.
+    u64*                 voxels;
+    // Allocated and kept along with the voxels, only valid for CHUNK_MIXED chunks.
+    ChunkMips*           mips;
+    // Type of each block, indexed the same way as the voxels. The voxels are kept in sync
+    // with it, a bit is set for every block that is not air.
+    BlockPalette         types;
+
+    // Returns a new empty storage with a single reference.
+    static ChunkStorage* create();
+    // Returns a new storage with a single reference and the same blocks.
+    ChunkStorage* clone() const;
+    void retain();
+    // Frees the storage when the last reference is released.
+    void release();
+
+    static inline u32 block_index(i32 x, i32 y, i32 z)
+    {
+        return ChunkLayout::index(x, y, z);
+    }
+
+    inline bool block(i32 x, i32 y, i32 z) const
+    {
+        if (fill != CHUNK_MIXED)
+            return fill == CHUNK_SOLID;
+        return voxel_get<ChunkLayout>(voxels, x, y, z);
+    }
+
+    inline BlockType block_type(i32 x, i32 y, i32 z) const
+    {
+        return types.get(block_index(x, y, z));
+    }
+
+    inline void set_block(i32 x, i32 y, i32 z, BlockType type)
+    {
+        types.set(block_index(x, y, z), type);
+
+        const bool exists = type != BLOCK_AIR;
+        if (fill != CHUNK_MIXED)
+        {
+            if (exists == (fill == CHUNK_SOLID)) return;
+            expand();
+        }
+        else if (exists == voxel_get<ChunkLayout>(voxels, x, y, z))
+        {
+            return;
+        }
+        if (exists) num_blocks++;
+        else num_blocks--;
+        voxel_set<ChunkLayout>(voxels, x, y, z, exists);
+        update_mips(x, y, z);
+    }
 
+    // A column is the stack of blocks of a x/z pair along the y axis, where bit y is set
+    // if the block at that height exists.
+    inline u32 column(i32 x, i32 z) const
+    {
+        if (fill != CHUNK_MIXED)
+            return fill == CHUNK_SOLID ? ~0u : 0u;
+        return ChunkLayout::column(voxels, x, z);
+    }
+
+    // Extracts every column of the chunk, indexed as [x][z]. Meshing and occluders work on
+    // the columns, so they do not depend on the layout.
+    void get_columns(u32 out[CHUNK_SIZE][CHUNK_SIZE]) const;
+
+    // Column of a mip level, with x and z in cells of that level. Level 0 is the same as column.
+    u32  mip_column(u32 level, i32 x, i32 z) const;
+    // True if any block exists inside the cell of a mip level.
+    inline bool mip_cell(u32 level, i32 x, i32 y, i32 z) const
+    {
+        return (mip_column(level, x, z) >> y) & 1;
+    }
+    // True if no block exists in the box between min and max, both inclusive, in blocks.
+    bool region_empty(i32 min_x, i32 min_y, i32 min_z, i32 max_x, i32 max_y, i32 max_z) const;
+
+    // Replaces all the blocks of the chunk from an array of BlockPalette::LENGTH types,
+    // indexed by block_index.
+    void set_blocks(const BlockType* new_types);
+    // Replaces the occupancy of the chunk, only keeping the voxels if they are not uniform.
+    void set_columns(const u32 new_columns[CHUNK_SIZE][CHUNK_SIZE]);
+    void set_voxels(const u64 new_voxels[VOXEL_LAYOUT_WORDS]);
+    // Fills the voxels of an uniform chunk, so single blocks can be changed. The blocks stay
+    // the same, and so does num_blocks.
+    void expand();
+    // Rebuilds the mips over a block that changed, stopping at the first level that did not.
+    void update_mips(i32 x, i32 y, i32 z);
+    void build_mips(const u32 columns[CHUNK_SIZE][CHUNK_SIZE]);
+    // Back to an empty chunk, keeping the allocations.
+    void clear();
+};
+
+// Immutable view of the blocks of a chunk at the time it was taken. Holds a reference to the
+// storage, so it stays valid while the chunk is edited or destroyed, until it is released.
+// Meant for readers on other threads, e.g. the remesh jobs of ChunkManager::update_dirty_meshes.
+struct ChunkSnapshot
+{
+    const ChunkStorage*  storage;
+    ChunkCoord           coord;
+    glm::vec3            position;
+
+    void release();
+};
+
+// A chunk of the world. Only touched when the chunk is built or edited, the render loops
+// read the ChunkRenderInfo and ChunkOccluders arrays of the manager instead.
 struct Chunk
 {
-    u32                  num_blocks;
-    u32                  num_vertices;
-    glm::vec3            max_vertices[8];
-    /* bool                 empty; */
-    GLuint               vao;
-    GLuint               vbo;
-    Material             material;
+    // The mesh is in the vertex buffer of the manager, in a range of reserved_vertices vertices
+    // from first_vertex. The chunk has no range while it is zero.
+    u32                  first_vertex;
+    u32                  reserved_vertices;
+    // Copy of the mesh in the vertex buffer, so edits only have to mesh the slices they touched.
+    // The builder threads mesh new chunks straight into it.
+    ChunkMesh            mesh;
+    // Slices to mesh again on the next ChunkManager::update_dirty_meshes.
+    ChunkDirtySlices     dirty;
+    // Set while a remesh job reads the mesh, which is not changed until the job is back.
+    bool                 remeshing;
+    ChunkCoord           coord;
     glm::vec3            position;
+    // Never null while the chunk is in use.
+    ChunkStorage*        storage;
+    // Position of the chunk in the pool, never changes.
+    u32                  slot;
+    u32                  generation;
+
+    inline ChunkHandle handle() const
+    {
+        return ChunkHandle{slot, generation};
+    }
+
+    static inline u32 block_index(i32 x, i32 y, i32 z)
+    {
+        return ChunkStorage::block_index(x, y, z);
+    }
+
+    inline bool block(i32 x, i32 y, i32 z) const
+    {
+        return storage->block(x, y, z);
+    }
+
+    inline BlockType block_type(i32 x, i32 y, i32 z) const
+    {
+        return storage->block_type(x, y, z);
+    }
+
+    inline u32 column(i32 x, i32 z) const
+    {
+        return storage->column(x, z);
+    }
+
+    inline void get_columns(u32 out[CHUNK_SIZE][CHUNK_SIZE]) const
+    {
+        storage->get_columns(out);
+    }
+
+    // Edits are copy on write: the first edit after a snapshot was taken copies the storage,
+    // the next ones write to the copy directly.
+    inline void set_block(i32 x, i32 y, i32 z, BlockType type)
+    {
+        writable_storage()->set_block(x, y, z, type);
+    }
+
+    // These replace every block, so a shared storage is left to the snapshots instead of copied.
+    void set_blocks(const BlockType* new_types);
+    void set_columns(const u32 new_columns[CHUNK_SIZE][CHUNK_SIZE]);
+
+    ChunkStorage* writable_storage();
+    ChunkSnapshot snapshot() const;
+};
+
+// Storage for every chunk of the manager. Chunks are allocated in pages that never move, so
+// pointers to them stay valid. Destroyed chunks go to a free list with their ChunkStorage
+// (voxels, mips and palette) and the vertices of their mesh copy, and their slot bumps its
+// generation. Once a streaming world reaches its working set, creating a chunk reuses those
+// allocations instead of making new ones. The chunks own no GL objects, their meshes are in
+// pages of the vertex buffer of the manager.
+struct ChunkPool
+{
+    static constexpr u32 PAGE_SIZE = 64;
+
+    Chunk**              pages;
+    u32                  num_pages;
+    u32*                 free_slots; // stack of the slots that can be acquired
+    u32                  num_free;
+
+    ChunkPool();
+    ~ChunkPool();
+
+    // The returned chunk has an empty storage and no dirty slices. Its slot and generation are
+    // set, and the vertices of its mesh copy are the ones of the chunk that had the slot last.
+    Chunk* acquire();
+    // Invalidates every handle to the chunk.
+    void   release(Chunk* chunk);
+    // Returns nullptr if the handle is stale.
+    Chunk* get(ChunkHandle handle) const;
+
+    inline Chunk& slot(u32 index) const
+    {
+        return pages[index / PAGE_SIZE][index % PAGE_SIZE];
+    }
+};
+
+// Per chunk data read every frame by culling and submission.
+struct ChunkRenderInfo
+{
+    glm::vec3            aabb_min;
+    glm::vec3            aabb_max;
+    u32                  num_vertices;
+    // Vertices of each face direction, in the inner part of the mesh and then in the border
+    // part. Inside each part the faces are contiguous and ordered as the Face enum, so only
+    // the directions that can face the camera have to be drawn.
+    u32                  face_vertices[MESH_PART_COUNT][FACE_COUNT];
+    // Base vertex of the draws of the chunk in the vertex buffer of the manager, always at the
+    // start of a page.
+    u32                  first_vertex;
+    u32                  shader;   // index into ChunkManager::shaders
+    u32                  material; // index into ChunkManager::materials
+};
+
+// We have two occluders for each direction of the main axis (x,y,z).
+// The bit of a face is set on the mask if an occluder was found for it.
+struct ChunkOccluders
+{
+    Quad3                quads[FACE_COUNT];
+    u32                  mask;
+};
+
+void build_chunk_occluders(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], glm::vec3 position,
+                           ChunkOccluders& occluders);
+
+// Shader that chunks are drawn with, and the locations of the uniforms that render_chunks
+// sets. The locations are looked up the first time the shader draws. The camera and the light
+// come from the FrameUniforms block.
+struct ChunkShader
+{
     Shader*              shader;
-    // Specifies the central point of the chunk on the map.
-    // Represents a three dimensional cube
-    //                           x coord.    y coord.    z coord.
-    Block                 blocks[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
-    // We have two occluders for each direction of the main axis (x,y,z)
-    Quad3                 occluders_data[FACE_COUNT];
-    Quad3*                occluders[FACE_COUNT];
+    bool                 has_locations;
+    GLuint               chunk_origins;
+    GLuint               ambient_color;
+    GLuint               diffuse_color;
+    GLuint               specular_color;
+    GLuint               shininess;
+};
+
+// Scratch of the draws of ChunkManager::render_chunks, grown with the number of chunks.
+struct ChunkDrawList
+{
+    // One item per visible chunk of the frame, their sort keys made by chunk_draw_key.
+    u64*                 items;
+    u32                  items_capacity;
+    // Arguments of glMultiDrawElementsBaseVertex, 2 * FACE_COUNT ranges per chunk at most.
+    GLsizei*             counts;
+    const GLvoid**       offsets;
+    GLint*               base_vertices;
 };
 
 struct ChunkManager
 {
-    u32            numUsed;
-    Chunk          chunks[WORLD_SIZE][WORLD_SIZE][WORLD_SIZE];
-    glm::vec3      position;
+    // In vertices, 4 MB. Doubled when a mesh does not fit.
+    static constexpr u32 INITIAL_VERTEX_BUFFER_SIZE = 1 << 20;
+    // The vertex buffer is handed out in pages of this many vertices, and a page only ever
+    // holds vertices of a single chunk. Same as VERTEX_PAGE_SIZE in the chunk vertex shaders.
+    static constexpr u32 VERTEX_PAGE_SIZE = 256;
+
+    // Only chunks with at least one block are allocated. They are kept in dense lists,
+    // which is what the render loops iterate over, and the map finds them by coordinate.
+    // The same index is used for the three lists.
+    ChunkPool         pool;
+    ChunkMap          map;
+    Chunk**           chunks;
+    ChunkRenderInfo*  render_infos;
+    ChunkOccluders*   occluders;
+    u32               num_chunks;
+    u32               chunks_capacity;
+    Material          materials[MAX_MATERIALS];
+    u32               num_materials;
+    // Added the first time a chunk is created with the shader.
+    ChunkShader       shaders[MAX_CHUNK_SHADERS];
+    u32               num_shaders;
+    glm::vec3         position;
+    // The meshes of all the chunks share one vertex array and one vertex buffer, in pages
+    // handed out by vertex_pages, so drawing them never switches vertex arrays. Every chunk
+    // draws the same index buffer of MAX_CHUNK_QUADS quads from its own base vertex.
+    GLuint            vao;
+    GLuint            vertex_buffer;
+    GLuint            quad_indices;
+    BufferAllocator   vertex_pages;
+    // Origin of the chunk of every page of the vertex buffer, read by the vertex shaders as a
+    // vec4 texture buffer. gl_VertexID includes the base vertex, so it finds the page and the
+    // chunks of a shader and material are drawn by a single call without per chunk uniforms.
+    GLuint            chunk_origins;
+    GLuint            chunk_origins_texture;
+    // Draws the occluders of render_occluders, written to the stream buffer every frame.
+    GLuint            occluders_vao;
+    ChunkDrawList     draw_list;
+    // Builds the chunks of request_chunk on other threads.
+    ChunkBuilder*     builder;
+    // The vertices of edited chunks are uploaded through it, the draws of the last frames may
+    // still read the pages that are written.
+    StreamBuffer*     stream;
+    // Chunks with dirty slices, found by coordinate since the dense lists move.
+    ChunkCoord*       dirty_chunks;
+    u32               num_dirty;
+    u32               dirty_capacity;
 
-    ChunkManager();
+    explicit ChunkManager(StreamBuffer* stream);
+    ~ChunkManager();
 
-    void create_chunk(u32 i, u32 j, u32 k, Shader* shader, Material material);
-    void render_chunks(const Frustum& frustum, const glm::mat4& view,
-                       const Memory& memory, const bool* keyboard) const;
-    void render_chunks_wireframe(const glm::mat4& view, const Shader* shader) const;
-    void render_occluders(const Camera& camera, const Memory& mem, const bool* keyboard) const;
+    u32  add_material(const Material& material);
+    // Returns a zeroed handle if the chunk has no blocks, since it is not stored.
+    // The mesh mode is kept when the chunk is remeshed.
+    ChunkHandle create_chunk(i32 x, i32 y, i32 z, Shader* shader, u32 material,
+                             ChunkMeshMode mesh_mode = MESH_FAST);
+    // Same as create_chunk, but the chunk is built by the builder threads and only added once
+    // upload_built_chunks finds it finished. Returns false if the builder is full, in which
+    // case the chunk has to be requested again later.
+    bool request_chunk(i32 x, i32 y, i32 z, Shader* shader, u32 material,
+                       ChunkMeshMode mesh_mode = MESH_FAST);
+    // Adds up to max_chunks chunks that the builder finished, uploading their meshes, along
+    // with every finished remesh. Never waits for the builder. Returns the number of chunks
+    // that were taken.
+    u32  upload_built_chunks(u32 max_chunks);
+    // Adds the chunk of a job built by build_chunk. Returns a zeroed handle if it is empty.
+    ChunkHandle add_built_chunk(ChunkBuildJob& job);
+    void destroy_chunk(i32 x, i32 y, i32 z);
+    // Returns a zeroed handle if the chunk is empty or was never created.
+    ChunkHandle chunk_handle(i32 x, i32 y, i32 z) const;
+    // Returns nullptr if the chunk was destroyed after the handle was taken.
+    Chunk* chunk(ChunkHandle handle) const;
+    // Border slices of the chunks around coord, missing chunks are air.
+    void chunk_borders(ChunkCoord coord, ChunkBorders& borders) const;
+    // Marks the border faces of the chunks around coord dirty, after the chunk there was
+    // created or destroyed.
+    void update_neighbour_borders(ChunkCoord coord);
+    // Marks slices of the chunk at index of the dense lists to be meshed again.
+    void mark_dirty(u32 index, const ChunkDirtySlices& dirty);
+    // Changes a block, in world block coordinates. Only the mesh slices that the block touches
+    // are marked dirty, in its chunk and in the neighbour when it is on a border. Placing a
+    // block in a chunk that is not stored adds the chunk, drawn with the shader and material
+    // of a neighbour.
+    void set_block(i32 x, i32 y, i32 z, BlockType type);
+    // Meshes the dirty slices of every chunk again and uploads the vertices that changed.
+    // Chunks with many dirty slices are meshed whole, chunks left without blocks are destroyed.
+    // The builder threads mesh a snapshot of the blocks, and upload_built_chunks uploads the
+    // result, so the edits go on meanwhile. Chunks are only meshed here when the builder has
+    // no free job. A chunk that is still being remeshed waits for the next call.
+    void update_dirty_meshes();
+    // True if the block exists, in world block coordinates. Missing chunks are empty.
+    bool block(i32 x, i32 y, i32 z) const;
+    // Draws the visible chunks with one call for each shader and material. The chunks are
+    // sorted by shader, material and then front to back, so every program is bound once and
+    // the uniforms are only set when they change.
+    void render_chunks(const Frustum& frustum, const Memory& memory, const bool* keyboard);
+    void render_chunks_wireframe(const Shader* shader);
+    // Draws the occluders of the visible chunks with a position only shader, e.g. "occluders".
+    void render_occluders(const Camera& camera, const Shader* shader, StreamBuffer& stream) const;
 };
 
 
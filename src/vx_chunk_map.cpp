@@ -0,0 +1,158 @@
+#include "vx_chunk_map.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+// Every coordinate is biased and packed in 21 bits, so a valid key never has the top bit set.
+static constexpr u64 EMPTY_KEY = ~0ull;
+static constexpr i32 COORD_BITS = 21;
+static constexpr i32 COORD_BIAS = 1 << (COORD_BITS - 1);
+static constexpr u64 COORD_MASK = (1ull << COORD_BITS) - 1;
+
+u64
+pack_coord(vx::ChunkCoord coord)
+{
+    ASSERT(coord.x >= -COORD_BIAS && coord.x < COORD_BIAS);
+    ASSERT(coord.y >= -COORD_BIAS && coord.y < COORD_BIAS);
+    ASSERT(coord.z >= -COORD_BIAS && coord.z < COORD_BIAS);
+
+    return (((u64)(coord.x + COORD_BIAS) & COORD_MASK) << (2 * COORD_BITS)) |
+           (((u64)(coord.y + COORD_BIAS) & COORD_MASK) << COORD_BITS) |
+           (((u64)(coord.z + COORD_BIAS) & COORD_MASK));
+}
+
+u64
+hash_key(u64 key)
+{
+    // splitmix64 finalizer, neighbouring coordinates end up far apart in the table.
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+vx::ChunkMap::ChunkMap(u32 initial_capacity)
+    : _capacity(16)
+    , _count(0)
+{
+    while (_capacity < initial_capacity)
+        _capacity <<= 1;
+
+    _keys = (u64*)malloc(sizeof(u64) * _capacity);
+    _values = (u32*)malloc(sizeof(u32) * _capacity);
+    memset(_keys, 0xFF, sizeof(u64) * _capacity);
+}
+
+vx::ChunkMap::~ChunkMap()
+{
+    free(_keys);
+    free(_values);
+}
+
+u32
+vx::ChunkMap::get(vx::ChunkCoord coord) const
+{
+    u64 key = pack_coord(coord);
+    u32 mask = _capacity - 1;
+
+    for (u32 i = hash_key(key) & mask; _keys[i] != EMPTY_KEY; i = (i + 1) & mask)
+    {
+        if (_keys[i] == key) return _values[i];
+    }
+    return INVALID;
+}
+
+void
+vx::ChunkMap::insert(vx::ChunkCoord coord, u32 value)
+{
+    // Keep the load factor under 3/4 so probe sequences stay short.
+    if ((_count + 1) * 4 > _capacity * 3)
+        grow();
+
+    u64 key = pack_coord(coord);
+    u32 mask = _capacity - 1;
+    u32 i = hash_key(key) & mask;
+
+    while (_keys[i] != EMPTY_KEY)
+    {
+        ASSERT(_keys[i] != key);
+        i = (i + 1) & mask;
+    }
+    _keys[i] = key;
+    _values[i] = value;
+    _count++;
+}
+
+void
+vx::ChunkMap::set(vx::ChunkCoord coord, u32 value)
+{
+    u64 key = pack_coord(coord);
+    u32 mask = _capacity - 1;
+
+    for (u32 i = hash_key(key) & mask; _keys[i] != EMPTY_KEY; i = (i + 1) & mask)
+    {
+        if (_keys[i] == key)
+        {
+            _values[i] = value;
+            return;
+        }
+    }
+    ASSERT(false);
+}
+
+void
+vx::ChunkMap::remove(vx::ChunkCoord coord)
+{
+    u64 key = pack_coord(coord);
+    u32 mask = _capacity - 1;
+    u32 i = hash_key(key) & mask;
+
+    while (_keys[i] != key)
+    {
+        ASSERT(_keys[i] != EMPTY_KEY);
+        i = (i + 1) & mask;
+    }
+    // Backward shift deletion: move up every following entry that would not be found anymore
+    // with the hole in its probe sequence, so no tombstones are needed.
+    u32 hole = i;
+    for (u32 j = (i + 1) & mask; _keys[j] != EMPTY_KEY; j = (j + 1) & mask)
+    {
+        u32 home = hash_key(_keys[j]) & mask;
+        // Distance from the home slot is smaller than the distance to the hole: stays.
+        if (((j - home) & mask) < ((j - hole) & mask)) continue;
+
+        _keys[hole] = _keys[j];
+        _values[hole] = _values[j];
+        hole = j;
+    }
+    _keys[hole] = EMPTY_KEY;
+    _count--;
+}
+
+void
+vx::ChunkMap::grow()
+{
+    u64* old_keys = _keys;
+    u32* old_values = _values;
+    u32 old_capacity = _capacity;
+
+    _capacity <<= 1;
+    _keys = (u64*)malloc(sizeof(u64) * _capacity);
+    _values = (u32*)malloc(sizeof(u32) * _capacity);
+    memset(_keys, 0xFF, sizeof(u64) * _capacity);
+
+    u32 mask = _capacity - 1;
+    for (u32 i = 0; i < old_capacity; i++)
+    {
+        if (old_keys[i] == EMPTY_KEY) continue;
+
+        u32 j = hash_key(old_keys[i]) & mask;
+        while (_keys[j] != EMPTY_KEY)
+            j = (j + 1) & mask;
+        _keys[j] = old_keys[i];
+        _values[j] = old_values[i];
+    }
+    free(old_keys);
+    free(old_values);
+}
@@ -0,0 +1,52 @@
+#ifndef VX_CHUNK_MAP_HPP
+#define VX_CHUNK_MAP_HPP
+
+#include "um.hpp"
+
+namespace vx
+{
+
+// Position of a chunk in the world, in chunk units. Can be negative.
+struct ChunkCoord
+{
+    i32 x, y, z;
+
+    ChunkCoord() {}
+    ChunkCoord(i32 x, i32 y, i32 z): x(x), y(y), z(z) {}
+
+    bool operator==(const ChunkCoord& rhs) const
+    {
+        return x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+};
+
+// Maps chunk coordinates to a u32 value (e.g. an index into a dense array of chunks).
+// Open addressing with linear probing, so a lookup is usually a single cache line.
+// Coordinates are limited to 21 bits per axis, i.e. [-2^20, 2^20).
+struct ChunkMap
+{
+    static constexpr u32 INVALID = 0xFFFFFFFF;
+
+    ChunkMap(u32 initial_capacity = 64);
+    ~ChunkMap();
+
+    // Returns INVALID if the coordinate is not present.
+    u32  get(ChunkCoord coord) const;
+    void insert(ChunkCoord coord, u32 value);
+    void set(ChunkCoord coord, u32 value);
+    void remove(ChunkCoord coord);
+
+    u32  count() const { return _count; }
+
+private:
+    u64* _keys;
+    u32* _values;
+    u32  _capacity; // always a power of two
+    u32  _count;
+
+    void grow();
+};
+
+}
+
+#endif // VX_CHUNK_MAP_HPP
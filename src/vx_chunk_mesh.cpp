@@ -0,0 +1,718 @@
+#include "vx_chunk_mesh.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+enum Axis
+{
+    AXIS_X, AXIS_Y, AXIS_Z,
+};
+
+// Transposes a square matrix of bits in place, i.e. bit j of row i becomes bit i of row j.
+// Used to turn the y columns of a chunk into rows along the x or z axis.
+void
+transpose_bits(u32 rows[vx::CHUNK_SIZE])
+{
+    u32 mask = 0x0000FFFF;
+    for (u32 j = 16; j != 0; j >>= 1, mask ^= (mask << j))
+    {
+        for (u32 k = 0; k < vx::CHUNK_SIZE; k = (k + j + 1) & ~j)
+        {
+            u32 t = ((rows[k] >> j) ^ rows[k + j]) & mask;
+            rows[k] ^= t << j;
+            rows[k + j] ^= t;
+        }
+    }
+}
+
+// How the faces of one side are laid out for meshing. The chunk is cut in slices along the
+// normal, and each slice is a 32x32 bit matrix of visible faces: one u32 row per cell along
+// the row axis, one bit per cell along the bit axis.
+struct FaceAxes
+{
+    Axis slice;
+    Axis row;
+    Axis bit;
+    // The face is on the positive side of the block along the slice axis.
+    bool positive;
+    // Going along the bit axis then the row axis turns counter clockwise seen from outside.
+    bool ccw;
+};
+
+static constexpr FaceAxes FACE_AXES[vx::FACE_COUNT] =
+{
+    { AXIS_Z, AXIS_X, AXIS_Y, false, true  }, // FACE_BACK
+    { AXIS_Z, AXIS_X, AXIS_Y, true,  false }, // FACE_FRONT
+    { AXIS_X, AXIS_Z, AXIS_Y, true,  true  }, // FACE_RIGHT
+    { AXIS_X, AXIS_Z, AXIS_Y, false, false }, // FACE_LEFT
+    { AXIS_Y, AXIS_Z, AXIS_X, true,  false }, // FACE_UP
+    { AXIS_Y, AXIS_Z, AXIS_X, false, true  }, // FACE_DOWN
+};
+
+// Column next to columns[x][z] on the side of the face, with bit y set if the neighbour of
+// the block at height y exists. Outside of the chunk the blocks come from the borders.
+template<vx::Face FACE>
+inline u32
+neighbour_column(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+                 i32 x, i32 z)
+{
+    const u32* border = borders.slices[FACE];
+    switch (FACE)
+    {
+        case vx::FACE_BACK:  return z > 0 ? columns[x][z-1] : border[x];
+        case vx::FACE_FRONT: return z < vx::CHUNK_SIZE-1 ? columns[x][z+1] : border[x];
+        case vx::FACE_RIGHT: return x < vx::CHUNK_SIZE-1 ? columns[x+1][z] : border[z];
+        case vx::FACE_LEFT:  return x > 0 ? columns[x-1][z] : border[z];
+        case vx::FACE_UP:    return (columns[x][z] >> 1) | (((border[x] >> z) & 1) << 31);
+        case vx::FACE_DOWN:  return (columns[x][z] << 1) | ((border[x] >> z) & 1);
+        default: return 0;
+    }
+}
+
+// Visible faces of one side of the chunk, indexed [slice][row] with one bit per cell along the
+// bit axis. A face is visible where a block exists and its neighbour does not, which is found
+// for 32 blocks at a time on the columns. The sides keep the bits of the columns along y, only
+// the top and bottom faces have to be transposed into slices. Only the slices in
+// [slice_begin, slice_end) are written.
+template<vx::Face FACE>
+void
+build_face_slices(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+                  i32 slice_begin, i32 slice_end, u32 slices[vx::CHUNK_SIZE][vx::CHUNK_SIZE])
+{
+    constexpr FaceAxes axes = FACE_AXES[FACE];
+    if (axes.slice == AXIS_X)
+    {
+        for (i32 x = slice_begin; x < slice_end; x++)
+            for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+                slices[x][z] = columns[x][z] & ~neighbour_column<FACE>(columns, borders, x, z);
+    }
+    else if (axes.slice == AXIS_Z)
+    {
+        for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+            for (i32 z = slice_begin; z < slice_end; z++)
+                slices[z][x] = columns[x][z] & ~neighbour_column<FACE>(columns, borders, x, z);
+    }
+    else if (slice_end - slice_begin == 1)
+    {
+        // A single slice, e.g. a border. Gathering its bit from every column is cheaper than
+        // transposing all of them.
+        const i32 y = slice_begin;
+        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+        {
+            u32 row = 0;
+            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+            {
+                const u32 visible = columns[x][z] & ~neighbour_column<FACE>(columns, borders, x, z);
+                row |= ((visible >> y) & 1) << x;
+            }
+            slices[y][z] = row;
+        }
+    }
+    else
+    {
+        u32 rows[vx::CHUNK_SIZE];
+        for (i32 z = 0; z < vx::CHUNK_SIZE; z++)
+        {
+            // Columns of the same z, transposed so rows are indexed by y with bits along x.
+            for (i32 x = 0; x < vx::CHUNK_SIZE; x++)
+                rows[x] = columns[x][z] & ~neighbour_column<FACE>(columns, borders, x, z);
+            transpose_bits(rows);
+            for (i32 y = slice_begin; y < slice_end; y++)
+                slices[y][z] = rows[y];
+        }
+    }
+}
+
+// Every row of a slice has 16 runs of faces at most. merge_fast starts at most one quad from
+// each run, so it never makes more than 16 quads per row. merge_minimal does not follow the
+// runs, its quads can split a run in several. The bound still holds for it because its quads
+// are a minimum partition of the slice into rectangles, and the quads of merge_fast are one
+// such partition, so merge_minimal never makes more quads than merge_fast.
+static constexpr u32 MAX_SLICE_VERTICES = vx::CHUNK_SIZE * vx::CHUNK_SIZE / 2 * 4;
+static constexpr u32 MIN_MESH_CAPACITY = 4096;
+
+// Grows the vertices of the mesh to hold at least count of them, doubling the capacity so a
+// mesh that is reused reaches the size it needs after a few builds.
+void
+reserve_mesh_vertices(vx::ChunkMesh& mesh, u32 count)
+{
+    if (count <= mesh.capacity) return;
+    ASSERT(count <= vx::MAX_CHUNK_MESH_SIZE);
+
+    u32 capacity = MAX(MIN_MESH_CAPACITY, mesh.capacity * 2);
+    while (capacity < count)
+        capacity *= 2;
+    mesh.capacity = MIN(capacity, vx::MAX_CHUNK_MESH_SIZE);
+    mesh.vertices = (vx::ChunkVertex*)realloc(mesh.vertices, sizeof(vx::ChunkVertex) * mesh.capacity);
+    ASSERT(mesh.vertices != NULL);
+}
+
+// First run of set bits in bits, which must not be zero.
+inline void
+first_run(u32 bits, u32& bit_begin, u32& length, u32& span)
+{
+    bit_begin = um::count_trailing_zeros(bits);
+    const u32 shifted = ~(bits >> bit_begin);
+    length = (shifted == 0) ? vx::CHUNK_SIZE - bit_begin : um::count_trailing_zeros(shifted);
+    span = (length == vx::CHUNK_SIZE) ? ~0u : (((1u << length) - 1) << bit_begin);
+}
+
+// Writes the 4 vertices of the quad covering [bit_begin, bit_end) x [row_begin, row_end) of
+// slice s.
+template<vx::Face FACE>
+inline void
+write_quad(vx::ChunkVertex* quad, u32 s, u32 bit_begin, u32 bit_end, u32 row_begin, u32 row_end)
+{
+    constexpr FaceAxes axes = FACE_AXES[FACE];
+    // Corners go around the quad starting at (bit_begin, row_begin) and moving along the bit
+    // axis first. When that is clockwise seen from outside they are written the other way.
+    static constexpr u32 CCW_ORDER[4] = { 0, 1, 2, 3 };
+    static constexpr u32 CW_ORDER[4] = { 0, 3, 2, 1 };
+    const u32* order = axes.ccw ? CCW_ORDER : CW_ORDER;
+
+    // Corners as block coordinates along the slice, bit and row axes.
+    const u32 bit_pos[2] = { bit_begin, bit_end };
+    const u32 row_pos[2] = { row_begin, row_end };
+    for (u32 i = 0; i < 4; i++)
+    {
+        const u32 corner = order[i];
+        u32 p[3];
+        p[axes.slice] = axes.positive ? s + 1 : s;
+        p[axes.bit] = bit_pos[(corner == 1 || corner == 2) ? 1 : 0];
+        p[axes.row] = row_pos[(corner >= 2) ? 1 : 0];
+        quad[i] = vx::pack_chunk_vertex(p[0], p[1], p[2], FACE);
+    }
+}
+
+// Greedy merge: each row is scanned for runs of faces, and a run grows over the next rows of
+// the slice for as long as they have the whole run too. Returns the vertices written.
+template<vx::Face FACE>
+u32
+merge_fast(u32 rows[vx::CHUNK_SIZE], u32 s, vx::ChunkVertex* vertices, u32& num_faces)
+{
+    u32 v = 0;
+    for (i32 row = 0; row < vx::CHUNK_SIZE; row++)
+    {
+        while (rows[row] != 0)
+        {
+            u32 bit_begin, length, span;
+            first_run(rows[row], bit_begin, length, span);
+
+            rows[row] &= ~span;
+            i32 row_end = row + 1;
+            while (row_end < vx::CHUNK_SIZE && (rows[row_end] & span) == span)
+                rows[row_end++] &= ~span;
+            num_faces += length * (row_end - row);
+
+            write_quad<FACE>(vertices + v, s, bit_begin, bit_begin + length, row, row_end);
+            v += 4;
+        }
+    }
+    return v;
+}
+
+// Cuts of a slice into rectangles, on the lines between its cells. Bit k of horizontal[j]
+// separates the cells (k, j-1) and (k, j), bit i of vertical[r] the cells (i-1, r) and (i, r),
+// a cell being (bit, row).
+struct SliceCuts
+{
+    u32 horizontal[vx::CHUNK_SIZE + 1];
+    u32 vertical[vx::CHUNK_SIZE];
+};
+
+// Corner of the cells of a slice with three of its four cells set, (i, j) being the corner
+// below and left of cell (i, j). A rectangle cannot have it as a corner, so some cut has to
+// leave it along the row line, towards di, or along the column line, towards dj, away from
+// the missing cell.
+struct ReflexCorner
+{
+    i8 i, j;
+    i8 di, dj;
+};
+
+// Cut between two reflex corners facing each other on a line, through set cells only. One
+// such cut takes care of both corners.
+struct Chord
+{
+    u16 from, to;
+};
+
+static constexpr u32 MAX_SLICE_CORNERS = (vx::CHUNK_SIZE + 1) * (vx::CHUNK_SIZE + 1);
+
+// Intersections of the horizontal and the vertical chords of a slice, as a bipartite graph.
+struct ChordGraph
+{
+    u16 edge_begin[MAX_SLICE_CORNERS + 1];
+    u16 edges[MAX_SLICE_CORNERS];
+    i16 horizontal_match[MAX_SLICE_CORNERS];
+    i16 vertical_match[MAX_SLICE_CORNERS];
+    u8  visited[MAX_SLICE_CORNERS];
+};
+
+inline bool
+cell_set(const u32 rows[vx::CHUNK_SIZE], i32 bit, i32 row)
+{
+    return bit >= 0 && bit < vx::CHUNK_SIZE && row >= 0 && row < vx::CHUNK_SIZE && ((rows[row] >> bit) & 1);
+}
+
+// A cut going through the corner (i, j) stops there, because it reached the border of the set
+// cells or another cut.
+inline bool
+cut_stops_at(const u32 rows[vx::CHUNK_SIZE], const SliceCuts& cuts, i32 i, i32 j)
+{
+    if (!cell_set(rows, i-1, j-1) || !cell_set(rows, i, j-1) || !cell_set(rows, i-1, j) || !cell_set(rows, i, j))
+        return true;
+    // Only corners inside the slice are left, so i - 1, i, j - 1 and j are all valid.
+    return ((cuts.horizontal[j] >> (i-1)) & 3) != 0 || ((cuts.vertical[j-1] | cuts.vertical[j]) >> i) & 1;
+}
+
+// Kuhn's augmenting path from horizontal chord h, returns true if the matching grew.
+bool
+augment_chords(ChordGraph& graph, u32 h)
+{
+    for (u32 e = graph.edge_begin[h]; e < graph.edge_begin[h+1]; e++)
+    {
+        const u32 v = graph.edges[e];
+        if (graph.visited[v]) continue;
+        graph.visited[v] = 1;
+        if (graph.vertical_match[v] < 0 || augment_chords(graph, graph.vertical_match[v]))
+        {
+            graph.vertical_match[v] = h;
+            graph.horizontal_match[h] = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Cuts a slice into the fewest rectangles. Every reflex corner needs a cut, and a chord takes
+// care of two corners at once, so the partition has the most chords that do not touch, then
+// one cut from each corner left. The chords that do not touch are the largest independent set
+// of their intersection graph, found from a maximum matching (Konig's theorem). See Ohtsuki,
+// "Minimum dissection of rectilinear regions", 1982.
+void
+partition_slice(const u32 rows[vx::CHUNK_SIZE], SliceCuts& cuts)
+{
+    static constexpr i32 N = vx::CHUNK_SIZE;
+    memset(&cuts, 0, sizeof(cuts));
+
+    ReflexCorner corners[MAX_SLICE_CORNERS];
+    u32 num_corners = 0;
+    i16 corner_at[N+1][N+1];
+    memset(corner_at, 0xff, sizeof(corner_at));
+    for (i32 j = 0; j <= N; j++)
+    {
+        // Cells around the corners of line j, bit i for corner i.
+        const u64 se = (j > 0) ? rows[j-1] : 0;
+        const u64 ne = (j < N) ? rows[j] : 0;
+        const u64 sw = se << 1;
+        const u64 nw = ne << 1;
+        for (u64 reflex = (sw & se & nw & ~ne) | (sw & se & ~nw & ne) | (sw & ~se & nw & ne) | (~sw & se & nw & ne);
+             reflex != 0; reflex &= reflex - 1)
+        {
+            const i32 i = um::count_trailing_zeros(reflex);
+            ReflexCorner& corner = corners[num_corners];
+            corner.i = i;
+            corner.j = j;
+            corner.di = (((sw & nw) >> i) & 1) ? -1 : 1;
+            corner.dj = (((sw & se) >> i) & 1) ? -1 : 1;
+            corner_at[i][j] = num_corners++;
+        }
+    }
+
+    // A chord leaves from the corner that faces right or up, the one at its end has to face
+    // back.
+    Chord horizontal[MAX_SLICE_CORNERS / 2];
+    Chord vertical[MAX_SLICE_CORNERS / 2];
+    u32 num_horizontal = 0, num_vertical = 0;
+    for (u32 c = 0; c < num_corners; c++)
+    {
+        const ReflexCorner& corner = corners[c];
+        if (corner.di > 0)
+        {
+            i32 i = corner.i;
+            while (cell_set(rows, i, corner.j-1) && cell_set(rows, i, corner.j)) i++;
+            const i32 end = corner_at[i][corner.j];
+            if (end >= 0 && corners[end].di < 0)
+                horizontal[num_horizontal++] = { (u16)c, (u16)end };
+        }
+        if (corner.dj > 0)
+        {
+            i32 j = corner.j;
+            while (cell_set(rows, corner.i-1, j) && cell_set(rows, corner.i, j)) j++;
+            const i32 end = corner_at[corner.i][j];
+            if (end >= 0 && corners[end].dj < 0)
+                vertical[num_vertical++] = { (u16)c, (u16)end };
+        }
+    }
+
+    // Chords on the same line never overlap, so every corner is on at most one vertical
+    // chord and the intersections are found from it.
+    i16 vertical_at[N+1][N+1];
+    memset(vertical_at, 0xff, sizeof(vertical_at));
+    for (u32 v = 0; v < num_vertical; v++)
+    {
+        const ReflexCorner& from = corners[vertical[v].from];
+        for (i32 j = from.j; j <= corners[vertical[v].to].j; j++)
+            vertical_at[from.i][j] = v;
+    }
+
+    ChordGraph graph;
+    u32 num_edges = 0;
+    for (u32 h = 0; h < num_horizontal; h++)
+    {
+        graph.edge_begin[h] = num_edges;
+        const ReflexCorner& from = corners[horizontal[h].from];
+        for (i32 i = from.i; i <= corners[horizontal[h].to].i; i++)
+            if (vertical_at[i][from.j] >= 0)
+                graph.edges[num_edges++] = vertical_at[i][from.j];
+    }
+    graph.edge_begin[num_horizontal] = num_edges;
+
+    memset(graph.horizontal_match, 0xff, sizeof(i16) * num_horizontal);
+    memset(graph.vertical_match, 0xff, sizeof(i16) * num_vertical);
+    for (u32 h = 0; h < num_horizontal; h++)
+    {
+        if (graph.edge_begin[h] == graph.edge_begin[h+1]) continue;
+        memset(graph.visited, 0, num_vertical);
+        augment_chords(graph, h);
+    }
+
+    // Konig: the chords reached by alternating paths from the unmatched horizontal ones make
+    // the cover on the vertical side, the independent set is the rest of the vertical chords
+    // and the reached horizontal ones.
+    u8 reached_horizontal[MAX_SLICE_CORNERS / 2] = {};
+    memset(graph.visited, 0, num_vertical);
+    u16 stack[MAX_SLICE_CORNERS / 2];
+    u32 stack_size = 0;
+    for (u32 h = 0; h < num_horizontal; h++)
+    {
+        if (graph.horizontal_match[h] >= 0) continue;
+        reached_horizontal[h] = 1;
+        stack[stack_size++] = h;
+    }
+    while (stack_size > 0)
+    {
+        const u32 h = stack[--stack_size];
+        for (u32 e = graph.edge_begin[h]; e < graph.edge_begin[h+1]; e++)
+        {
+            const u32 v = graph.edges[e];
+            if (graph.visited[v]) continue;
+            graph.visited[v] = 1;
+            // Every vertical chord reached is matched, or the matching would not be maximum.
+            const u32 next = graph.vertical_match[v];
+            if (!reached_horizontal[next])
+            {
+                reached_horizontal[next] = 1;
+                stack[stack_size++] = next;
+            }
+        }
+    }
+
+    for (u32 h = 0; h < num_horizontal; h++)
+    {
+        if (!reached_horizontal[h]) continue;
+        const ReflexCorner& from = corners[horizontal[h].from];
+        const ReflexCorner& to = corners[horizontal[h].to];
+        cuts.horizontal[from.j] |= (u32)(((1ull << (to.i - from.i)) - 1) << from.i);
+    }
+    for (u32 v = 0; v < num_vertical; v++)
+    {
+        if (graph.visited[v]) continue;
+        const ReflexCorner& from = corners[vertical[v].from];
+        for (i32 j = from.j; j < corners[vertical[v].to].j; j++)
+            cuts.vertical[j] |= 1u << from.i;
+    }
+
+    // The corners that are not on a chord get a cut along the row line, up to the first cut
+    // or border it meets.
+    for (u32 c = 0; c < num_corners; c++)
+    {
+        const ReflexCorner& corner = corners[c];
+        const i32 edge_i = (corner.di > 0) ? corner.i : corner.i - 1;
+        const i32 edge_j = (corner.dj > 0) ? corner.j : corner.j - 1;
+        if (((cuts.horizontal[corner.j] >> edge_i) & 1) || ((cuts.vertical[edge_j] >> corner.i) & 1))
+            continue;
+
+        for (i32 i = corner.i; ; i += corner.di)
+        {
+            const bool stop = cut_stops_at(rows, cuts, i + corner.di, corner.j);
+            cuts.horizontal[corner.j] |= 1u << ((corner.di > 0) ? i : i - 1);
+            if (stop) break;
+        }
+    }
+}
+
+// Minimum partition of the slice into rectangles, see partition_slice. Far slower than
+// merge_fast, mostly on noisy slices with many corners.
+template<vx::Face FACE>
+u32
+merge_minimal(u32 rows[vx::CHUNK_SIZE], u32 s, vx::ChunkVertex* vertices, u32& num_faces)
+{
+    SliceCuts cuts;
+    partition_slice(rows, cuts);
+
+    // Every piece left between the cuts is a rectangle, found from its first cell.
+    u32 v = 0;
+    for (i32 row = 0; row < vx::CHUNK_SIZE; row++)
+    {
+        while (rows[row] != 0)
+        {
+            u32 bit_begin, length, span;
+            first_run(rows[row], bit_begin, length, span);
+            const u32 cut = cuts.vertical[row] & span & ~(1u << bit_begin);
+            if (cut != 0)
+            {
+                length = um::count_trailing_zeros(cut) - bit_begin;
+                span = (((1u << length) - 1) << bit_begin);
+            }
+
+            rows[row] &= ~span;
+            i32 row_end = row + 1;
+            while (row_end < vx::CHUNK_SIZE && (rows[row_end] & span) == span && (cuts.horizontal[row_end] & span) == 0)
+                rows[row_end++] &= ~span;
+            num_faces += length * (row_end - row);
+
+            write_quad<FACE>(vertices + v, s, bit_begin, bit_begin + length, row, row_end);
+            v += 4;
+        }
+    }
+    return v;
+}
+
+// Meshes one side of the chunk. The vertices are appended to the part of the mesh, and the
+// slices are set.
+template<vx::Face FACE>
+void
+mesh_faces(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+           i32 slice_begin, i32 slice_end, vx::ChunkMesh& mesh, vx::ChunkMeshPart part)
+{
+    u32 slices[vx::CHUNK_SIZE][vx::CHUNK_SIZE];
+    build_face_slices<FACE>(columns, borders, slice_begin, slice_end, slices);
+
+    const u32 first = mesh.num_vertices;
+    u32 v = first;
+    u32 num_faces = 0;
+    for (i32 s = slice_begin; s < slice_end; s++)
+    {
+        reserve_mesh_vertices(mesh, MIN(v + MAX_SLICE_VERTICES, vx::MAX_CHUNK_MESH_SIZE));
+        const u32 num_slice_vertices = (mesh.mode == vx::MESH_MINIMAL)
+            ? merge_minimal<FACE>(slices[s], s, mesh.vertices + v, num_faces)
+            : merge_fast<FACE>(slices[s], s, mesh.vertices + v, num_faces);
+        ASSERT(num_slice_vertices <= MAX_SLICE_VERTICES);
+        mesh.slice_vertices[FACE][s] = (u16)num_slice_vertices;
+        v += num_slice_vertices;
+    }
+    mesh.num_vertices = v;
+    mesh.face_vertices[part][FACE] += v - first;
+    mesh.num_faces[part] += num_faces;
+}
+
+// Only frees the vertices, when the thread of the scratch mesh exits.
+struct ScratchMesh
+{
+    vx::ChunkMesh mesh;
+
+    ~ScratchMesh()
+    {
+        free(this->mesh.vertices);
+    }
+};
+
+vx::ChunkMesh&
+vx::scratch_mesh()
+{
+    static thread_local ScratchMesh scratch;
+    return scratch.mesh;
+}
+
+void
+vx::build_quad_indices(u32* indices, u32 num_quads)
+{
+    for (u32 q = 0; q < num_quads; q++)
+    {
+        const u32 first = q * 4;
+        u32* quad = indices + q * QUAD_INDICES;
+        quad[0] = first;
+        quad[1] = first + 1;
+        quad[2] = first + 2;
+        quad[3] = first + 2;
+        quad[4] = first + 3;
+        quad[5] = first;
+    }
+}
+
+template<vx::Face FACE>
+void
+mesh_inner_faces(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+                 vx::ChunkMesh& mesh)
+{
+    // None of these faces look past the border of the chunk, so the borders are never read.
+    const i32 begin = FACE_AXES[FACE].positive ? 0 : 1;
+    mesh_faces<FACE>(columns, borders, begin, begin + vx::CHUNK_SIZE-1, mesh, vx::MESH_INNER);
+}
+
+template<vx::Face FACE>
+void
+mesh_border_faces(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+                  vx::ChunkMesh& mesh)
+{
+    const i32 border = FACE_AXES[FACE].positive ? vx::CHUNK_SIZE-1 : 0;
+    mesh_faces<FACE>(columns, borders, border, border + 1, mesh, vx::MESH_BORDER);
+}
+
+void
+vx::build_chunk_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const vx::ChunkBorders& borders,
+                     vx::ChunkMesh& mesh, vx::ChunkMeshMode mode)
+{
+    mesh.mode = mode;
+    mesh.num_vertices = 0;
+    mesh.num_faces[MESH_INNER] = 0;
+    memset(mesh.face_vertices[MESH_INNER], 0, sizeof(mesh.face_vertices[MESH_INNER]));
+    mesh_inner_faces<FACE_BACK>(columns, borders, mesh);
+    mesh_inner_faces<FACE_FRONT>(columns, borders, mesh);
+    mesh_inner_faces<FACE_RIGHT>(columns, borders, mesh);
+    mesh_inner_faces<FACE_LEFT>(columns, borders, mesh);
+    mesh_inner_faces<FACE_UP>(columns, borders, mesh);
+    mesh_inner_faces<FACE_DOWN>(columns, borders, mesh);
+    mesh.num_inner_vertices = mesh.num_vertices;
+
+    build_chunk_border_mesh(columns, borders, mesh);
+}
+
+void
+vx::build_chunk_border_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const vx::ChunkBorders& borders,
+                            vx::ChunkMesh& mesh)
+{
+    mesh.num_vertices = mesh.num_inner_vertices;
+    mesh.num_faces[MESH_BORDER] = 0;
+    memset(mesh.face_vertices[MESH_BORDER], 0, sizeof(mesh.face_vertices[MESH_BORDER]));
+    mesh_border_faces<FACE_BACK>(columns, borders, mesh);
+    mesh_border_faces<FACE_FRONT>(columns, borders, mesh);
+    mesh_border_faces<FACE_RIGHT>(columns, borders, mesh);
+    mesh_border_faces<FACE_LEFT>(columns, borders, mesh);
+    mesh_border_faces<FACE_UP>(columns, borders, mesh);
+    mesh_border_faces<FACE_DOWN>(columns, borders, mesh);
+    ASSERT(mesh.num_vertices <= MAX_CHUNK_MESH_SIZE);
+}
+
+void
+vx::mark_dirty_block(vx::ChunkDirtySlices& dirty, i32 x, i32 y, i32 z)
+{
+    const i32 pos[3] = { x, y, z };
+    for (u32 face = 0; face < FACE_COUNT; face++)
+    {
+        const FaceAxes& axes = FACE_AXES[face];
+        const i32 slice = pos[axes.slice];
+        // The block that has this one as its neighbour on the side of the face.
+        const i32 behind = axes.positive ? slice - 1 : slice + 1;
+        dirty.masks[face] |= 1u << slice;
+        if (behind >= 0 && behind < CHUNK_SIZE)
+            dirty.masks[face] |= 1u << behind;
+    }
+}
+
+// Block faces merged into a quad. Corners 0 and 2 are opposite in both windings, and the quad
+// is flat along the normal.
+u32
+quad_faces(const vx::ChunkVertex* quad)
+{
+    u32 faces = 1;
+    for (u32 shift = 0; shift < 18; shift += 6)
+    {
+        const i32 a = (quad[0] >> shift) & 63;
+        const i32 b = (quad[2] >> shift) & 63;
+        if (a != b) faces *= (a > b) ? a - b : b - a;
+    }
+    return faces;
+}
+
+// Slices of one direction in one part for update_chunk_mesh. Runs of clean slices are copied
+// from mesh at src with a single copy, runs of dirty slices are meshed together.
+template<vx::Face FACE>
+void
+update_faces(const u32 columns[vx::CHUNK_SIZE][vx::CHUNK_SIZE], const vx::ChunkBorders& borders,
+             const vx::ChunkDirtySlices& dirty, vx::ChunkMeshPart part, const vx::ChunkMesh& mesh,
+             u32& src, vx::ChunkMesh& out, u32& first_changed, u32& changed_end)
+{
+    const bool positive = FACE_AXES[FACE].positive;
+    i32 begin, end;
+    if (part == vx::MESH_INNER)
+    {
+        begin = positive ? 0 : 1;
+        end = begin + vx::CHUNK_SIZE-1;
+    }
+    else
+    {
+        begin = positive ? vx::CHUNK_SIZE-1 : 0;
+        end = begin + 1;
+    }
+
+    const u32 mask = dirty.masks[FACE];
+    for (i32 s = begin; s < end;)
+    {
+        const bool is_dirty = (mask >> s) & 1;
+        i32 run_end = s + 1;
+        while (run_end < end && ((mask >> run_end) & 1) == is_dirty)
+            run_end++;
+
+        u32 num_old = 0;
+        for (i32 k = s; k < run_end; k++)
+            num_old += mesh.slice_vertices[FACE][k];
+
+        if (is_dirty)
+        {
+            first_changed = MIN(first_changed, out.num_vertices);
+            for (u32 q = src; q < src + num_old; q += 4)
+                out.num_faces[part] -= quad_faces(mesh.vertices + q);
+            mesh_faces<FACE>(columns, borders, s, run_end, out, part);
+            changed_end = out.num_vertices;
+        }
+        else
+        {
+            // Clean slices only change when the dirty ones before them changed size.
+            if (out.num_vertices != src)
+                changed_end = out.num_vertices + num_old;
+            reserve_mesh_vertices(out, out.num_vertices + num_old);
+            memcpy(out.vertices + out.num_vertices, mesh.vertices + src, sizeof(vx::ChunkVertex) * num_old);
+            memcpy(&out.slice_vertices[FACE][s], &mesh.slice_vertices[FACE][s], sizeof(u16) * (run_end - s));
+            out.num_vertices += num_old;
+            out.face_vertices[part][FACE] += num_old;
+        }
+        src += num_old;
+        s = run_end;
+    }
+}
+
+u32
+vx::update_chunk_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const vx::ChunkBorders& borders,
+                      const vx::ChunkDirtySlices& dirty, const vx::ChunkMesh& mesh, vx::ChunkMesh& out,
+                      u32& changed_end)
+{
+    out.mode = mesh.mode;
+    out.num_vertices = 0;
+    out.num_faces[MESH_INNER] = mesh.num_faces[MESH_INNER];
+    out.num_faces[MESH_BORDER] = mesh.num_faces[MESH_BORDER];
+    memset(out.face_vertices, 0, sizeof(out.face_vertices));
+
+    u32 src = 0;
+    u32 first_changed = ~0u;
+    changed_end = 0;
+    for (u32 i = 0; i < MESH_PART_COUNT; i++)
+    {
+        const ChunkMeshPart part = (ChunkMeshPart)i;
+        if (part == MESH_BORDER)
+            out.num_inner_vertices = out.num_vertices;
+        update_faces<FACE_BACK>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+        update_faces<FACE_FRONT>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+        update_faces<FACE_RIGHT>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+        update_faces<FACE_LEFT>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+        update_faces<FACE_UP>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+        update_faces<FACE_DOWN>(columns, borders, dirty, part, mesh, src, out, first_changed, changed_end);
+    }
+    ASSERT(src == mesh.num_vertices);
+    ASSERT(out.num_vertices <= MAX_CHUNK_MESH_SIZE);
+
+    first_changed = MIN(first_changed, out.num_vertices);
+    changed_end = MAX(changed_end, first_changed);
+    return first_changed;
+}
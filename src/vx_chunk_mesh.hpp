@@ -0,0 +1,148 @@
+#ifndef VX_CHUNK_MESH_HPP
+#define VX_CHUNK_MESH_HPP
+
+#include "um.hpp"
+
+// CPU side of the chunk meshes. Nothing here touches OpenGL, so meshes can be built on any
+// thread, or without a window at all, e.g. by the benchmarks. ChunkManager uploads them.
+
+namespace vx
+{
+
+enum Face
+{
+    FACE_BACK, FACE_FRONT, FACE_RIGHT, FACE_LEFT, FACE_UP, FACE_DOWN, FACE_COUNT
+};
+
+static constexpr u8 CHUNK_SIZE_LOG2 = 5;
+static constexpr u8 CHUNK_SIZE = 1 << CHUNK_SIZE_LOG2;
+
+// Slice on the border of the chunk on the side of each face, the opposite face is face ^ 1.
+static constexpr u32 FACE_BORDER_SLICES[FACE_COUNT] =
+{
+    0, CHUNK_SIZE-1, CHUNK_SIZE-1, 0, CHUNK_SIZE-1, 0
+};
+
+// Vertex of a chunk mesh, packed in 32 bits:
+//   bits  0-17  x, y and z in blocks inside the chunk, 6 bits each since a corner can be at 32
+//   bits 18-20  Face, the vertex shader looks the normal up from it
+//   bits 21-31  free for the block type and ambient occlusion, zero for now
+// The world position adds the origin of the chunk, which the shader reads from the chunk_origins
+// texture buffer of the manager, one entry per page of 256 vertices found by gl_VertexID / 256.
+typedef u32 ChunkVertex;
+
+static constexpr u32 CHUNK_VERTEX_FACE_SHIFT = 18;
+static constexpr u32 CHUNK_VERTEX_DATA_SHIFT = 21;
+
+inline ChunkVertex
+pack_chunk_vertex(u32 x, u32 y, u32 z, Face face)
+{
+    return x | (y << 6) | (z << 12) | ((u32)face << CHUNK_VERTEX_FACE_SHIFT);
+}
+
+// Upper bound of the quads in the mesh of a chunk. A visible side belongs to a solid block and
+// is either on the border of the chunk or next to an empty block, so the count peaks when half
+// of the blocks are solid.
+static constexpr u32 MAX_CHUNK_QUADS =
+    6 * (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE / 2) + 6 * CHUNK_SIZE * CHUNK_SIZE;
+
+// Every quad is four vertices, going around it counter clockwise seen from outside. They are
+// drawn as the triangles (0, 1, 2) and (2, 3, 0) by a single index buffer shared by all the
+// chunks, see build_quad_indices.
+static constexpr u32 MAX_CHUNK_MESH_SIZE = MAX_CHUNK_QUADS * 4;
+static constexpr u32 QUAD_INDICES = 6;
+
+// Fills the indices of num_quads quads, the index buffer needs num_quads * QUAD_INDICES.
+void build_quad_indices(u32* indices, u32 num_quads);
+
+// Blocks of the six neighbouring chunks that touch a chunk, so the mesher can skip the faces
+// on the borders of the chunk that they hide. Indexed by the face the neighbour is on:
+//   back, front   [x] column at z = 31 and z = 0 of the neighbour
+//   right, left   [z] column at x = 0 and x = 31 of the neighbour
+//   up, down      [x] with bit z set if the block at y = 0 or y = 31 of the neighbour exists
+// Zeroed slices are air, e.g. for neighbours that are not loaded.
+struct ChunkBorders
+{
+    u32                  slices[FACE_COUNT][CHUNK_SIZE];
+};
+
+// Parts of a chunk mesh. The faces inside the chunk do not depend on the neighbours and come
+// first, the faces on the six borders follow them so they can be rebuilt alone.
+enum ChunkMeshPart
+{
+    MESH_INNER, MESH_BORDER, MESH_PART_COUNT
+};
+
+// How faces are merged into quads.
+enum ChunkMeshMode
+{
+    // Greedy merge in scan order, for chunks that are meshed often, e.g. while edited.
+    MESH_FAST,
+    // Fewest quads possible for every slice, a few times slower than MESH_FAST. For chunks
+    // that are meshed once and drawn for a long time.
+    MESH_MINIMAL,
+};
+
+// Output of the mesher. The vertices are owned by the caller, and the mesher grows them with
+// realloc when they are short, so they come from malloc or are null with a zero capacity.
+// Everything else is filled by the mesher.
+struct ChunkMesh
+{
+    ChunkVertex*         vertices;
+    u32                  capacity;
+    // Set by build_chunk_mesh, the border and update functions mesh with the same mode.
+    ChunkMeshMode        mode;
+    u32                  num_vertices;
+    u32                  num_inner_vertices;
+    // Vertices of each face direction in each part. Inside a part the directions are
+    // contiguous and ordered as the Face enum.
+    u32                  face_vertices[MESH_PART_COUNT][FACE_COUNT];
+    // Visible block faces of each part before they were merged into quads.
+    u32                  num_faces[MESH_PART_COUNT];
+    // Vertices of each slice of each face direction, slice s being the blocks at s along the
+    // normal. The slices of a direction follow each other in order, the border slice is in
+    // the border part and the others in the inner part.
+    u16                  slice_vertices[FACE_COUNT][CHUNK_SIZE];
+};
+
+// Slices of a chunk mesh that have to be rebuilt after its blocks changed, bit s of a face
+// direction for slice s. The border slices are also dirty when the neighbour next to them
+// changed.
+struct ChunkDirtySlices
+{
+    u32                  masks[FACE_COUNT];
+};
+
+// Marks the slices whose faces depend on the block at x, y, z: the slice of the block itself,
+// and the one of the blocks that have it as their neighbour.
+void mark_dirty_block(ChunkDirtySlices& dirty, i32 x, i32 y, i32 z);
+
+// Past this many dirty slices update_chunk_mesh is not worth it over build_chunk_mesh, which
+// builds the slices of a direction together.
+static constexpr u32 MAX_DIRTY_SLICES = FACE_COUNT * CHUNK_SIZE / 4;
+
+// Mesh owned by the calling thread, to build meshes into before they are copied out. Its
+// vertices start small, grow geometrically up to MAX_CHUNK_MESH_SIZE with the meshes that need
+// them and are kept for the next ones, then freed when the thread exits.
+ChunkMesh& scratch_mesh();
+
+// Builds the greedy mesh of a chunk from its columns (see Chunk::get_columns).
+void build_chunk_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const ChunkBorders& borders,
+                      ChunkMesh& mesh, ChunkMeshMode mode = MESH_FAST);
+// Rebuilds only the border part of a mesh after the borders changed. The inner part of the
+// mesh is kept as it is.
+void build_chunk_border_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const ChunkBorders& borders,
+                             ChunkMesh& mesh);
+// Builds into out the mesh of the chunk after some of its slices changed. The dirty slices are
+// meshed again and the others are copied from mesh, which was built from the old columns.
+// Returns the first vertex of out that differs from mesh, and sets changed_end past the last
+// one. The vertices outside of that range are the same in both, so only the range has to be
+// uploaded. When the dirty slices keep their number of vertices the range only covers them,
+// otherwise every slice after them moved and the range goes to the end of the mesh.
+u32  update_chunk_mesh(const u32 columns[CHUNK_SIZE][CHUNK_SIZE], const ChunkBorders& borders,
+                       const ChunkDirtySlices& dirty, const ChunkMesh& mesh, ChunkMesh& out,
+                       u32& changed_end);
+
+}
+
+#endif // VX_CHUNK_MESH_HPP
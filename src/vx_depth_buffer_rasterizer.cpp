@@ -93,7 +93,7 @@ vx::DepthBufferRasterizer::draw_to_image(const char* filename) const
 }
 
 void
-vx::DepthBufferRasterizer::draw_occluders(const Frustum& frustum, Quad3* occluders[vx::FACE_COUNT])
+vx::DepthBufferRasterizer::draw_occluders(const Frustum& frustum, const ChunkOccluders& occluders)
 {
     using vec2 = glm::vec2;
     using vec3 = glm::vec3;
@@ -102,16 +102,16 @@ vx::DepthBufferRasterizer::draw_occluders(const Frustum& frustum, Quad3* occlude
 
     for (u32 i = 0; i < vx::FACE_COUNT; i++)
     {
-        if (occluders[i] == nullptr) continue;
+        if ((occluders.mask & (1u << i)) == 0) continue;
 
         // Apply perspective divide
         // screen_space.x = camera_space.x / camera_space.z
         // screen_space.y = camera_space.y / camera_space.z
 
-        vec4 camera_p1 = _view * vec4(occluders[i]->p1, 1.0f);
-        vec4 camera_p2 = _view * vec4(occluders[i]->p2, 1.0f);
-        vec4 camera_p3 = _view * vec4(occluders[i]->p3, 1.0f);
-        vec4 camera_p4 = _view * vec4(occluders[i]->p4, 1.0f);
+        vec4 camera_p1 = _view * vec4(occluders.quads[i].p1, 1.0f);
+        vec4 camera_p2 = _view * vec4(occluders.quads[i].p2, 1.0f);
+        vec4 camera_p3 = _view * vec4(occluders.quads[i].p3, 1.0f);
+        vec4 camera_p4 = _view * vec4(occluders.quads[i].p4, 1.0f);
 
         // TODO(Leo): I have to clip the coordinates
         vec4 clip_p1 = _proj * camera_p1;
@@ -28,7 +28,7 @@ struct DepthBufferRasterizer
 
     void draw_triangle(Point3 unsorted_v0, Point3 unsorted_v1, Point3 unsorted_v2);
     void draw_to_image(const char* filename) const;
-    void draw_occluders(const Frustum& frustum, Quad3* occluders[vx::FACE_COUNT]);
+    void draw_occluders(const Frustum& frustum, const ChunkOccluders& occluders);
 
     void set_projection_matrix(const glm::mat4& proj);
     void set_view_matrix(const glm::mat4& view);
@@ -4,7 +4,7 @@
 #include "vx_chunk_manager.hpp"
 
 bool
-vx::Frustum::chunk_inside(const vx::Chunk& chunk) const
+vx::Frustum::chunk_inside(const vx::ChunkRenderInfo& chunk) const
 {
     using vec3 = glm::vec3;
 
@@ -57,6 +57,19 @@ vx::Frustum::chunk_inside(const vx::Chunk& chunk) const
         nearTopLeft,
     };
 
+    // Extreme vertices of the chunk, the order of them does not matter.
+    vec3 chunkVertices[8] =
+    {
+        chunk.aabb_min,
+        vec3(chunk.aabb_min.x, chunk.aabb_min.y, chunk.aabb_max.z),
+        vec3(chunk.aabb_min.x, chunk.aabb_max.y, chunk.aabb_min.z),
+        vec3(chunk.aabb_max.x, chunk.aabb_min.y, chunk.aabb_min.z),
+        vec3(chunk.aabb_min.x, chunk.aabb_max.y, chunk.aabb_max.z),
+        vec3(chunk.aabb_max.x, chunk.aabb_max.y, chunk.aabb_min.z),
+        vec3(chunk.aabb_max.x, chunk.aabb_min.y, chunk.aabb_max.z),
+        chunk.aabb_max,
+    };
+
     bool insideFrustum = true;
     vec3 pointVec;
     for (i32 p = 0; p < 6; p++)
@@ -64,7 +77,7 @@ vx::Frustum::chunk_inside(const vx::Chunk& chunk) const
         bool insidePlane = false;
         for (i32 v = 0; v < 8; v++)
         {
-            pointVec = frustumPoints[p] - chunk.max_vertices[v];
+            pointVec = frustumPoints[p] - chunkVertices[v];
             if (glm::dot(pointVec, frustumNormals[p]) >= 0.0f)
             {
                 insidePlane = true;
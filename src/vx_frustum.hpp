@@ -9,7 +9,7 @@
 namespace vx
 {
 
-struct Chunk;
+struct ChunkRenderInfo;
 
 struct Frustum
 {
@@ -35,7 +35,7 @@ struct Frustum
 
     glm::mat4 projection;
 
-    bool chunk_inside(const Chunk& chunk) const;
+    bool chunk_inside(const ChunkRenderInfo& chunk) const;
 };
 
 }
@@ -10,6 +10,7 @@ struct LogManager;
 struct ChunkManager;
 struct Display;
 struct DepthBufferRasterizer;
+struct StreamBuffer;
 
 
 struct Memory
@@ -20,6 +21,8 @@ struct Memory
     ChunkManager*           chunk_manager;
     Display*                display;
     DepthBufferRasterizer*  depth_buf;
+    // Vertices written every frame, shared by everything that draws them.
+    StreamBuffer*           stream_buffer;
 };
 
 }
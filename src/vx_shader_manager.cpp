@@ -5,6 +5,7 @@
 #include "um.hpp"
 #include "vx_string_hashmap.hpp"
 #include "vx_shader_manager.hpp"
+#include "vx_stream_buffer.hpp"
 
 #define NUM_BUCKETS 26
 
@@ -20,9 +21,14 @@ shader_free(void *data)
     free(shader);
 }
 
-vx::ShaderManager::ShaderManager()
+vx::ShaderManager::ShaderManager(vx::StreamBuffer* stream)
+    : stream(stream)
 {
     this->shaders = vx::string_hashmap_new(NUM_BUCKETS);
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    this->uniform_alignment = alignment > 0 ? (u32)alignment : 256;
 }
 
 vx::ShaderManager::~ShaderManager()
@@ -66,6 +72,9 @@ vx::ShaderManager::load_program(const char* shader_name)
     DEBUG("fragment: %s\n", fragmentPath);
 
     GLuint program = make_program(vertexPath, fragmentPath);
+    GLuint frame_block = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (frame_block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, frame_block, vx::FRAME_UNIFORMS_BINDING);
     //
     // Alloc new shader
     //
@@ -80,6 +89,15 @@ vx::ShaderManager::load_program(const char* shader_name)
     return shader;
 }
 
+void
+vx::ShaderManager::update_frame_uniforms(const vx::FrameUniforms& uniforms)
+{
+    // A fresh range of the ring every frame, the draws of the last frames keep reading theirs.
+    const u32 offset = this->stream->write(&uniforms, sizeof(uniforms), this->uniform_alignment);
+    glBindBufferRange(GL_UNIFORM_BUFFER, vx::FRAME_UNIFORMS_BINDING, this->stream->buffer,
+                      offset, sizeof(uniforms));
+}
+
 char *
 shader_from_src(const char *filepath)
 {
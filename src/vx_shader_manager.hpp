@@ -2,6 +2,8 @@
 #define VX_SHADER_MANAGER_HPP
 
 #include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "um.hpp"
 
 #ifndef SHADERS_PATH
 #define SHADERS_PATH "resources/shaders/"
@@ -11,6 +13,7 @@ namespace vx
 {
 
 struct StringHashmap;
+struct StreamBuffer;
 
 struct Shader
 {
@@ -22,14 +25,39 @@ struct Shader
     GLuint uniform_location(const char* uniform_name) const;
 };
 
+// Binding point of the FrameUniforms block. Programs that declare the block are bound to it
+// when they are loaded.
+static constexpr GLuint FRAME_UNIFORMS_BINDING = 0;
+
+// Uniforms that are the same for every program during a frame, laid out as the std140
+// FrameUniforms block of the shaders. The vec3s of the block take a vec4 each.
+struct FrameUniforms
+{
+    glm::mat4          view;
+    glm::mat4          projection;
+    glm::mat4          view_projection;
+    glm::vec4          camera_position;
+    glm::vec4          light_position;
+    glm::vec4          light_color;
+};
+
+static_assert(sizeof(FrameUniforms) == 3 * 64 + 3 * 16, "Has to match the std140 layout");
+
 struct ShaderManager
 {
     StringHashmap* shaders;
+    // The FrameUniforms are written to it every frame and bound from there.
+    StreamBuffer*  stream;
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, the offsets of the bound ranges are multiples of it.
+    u32            uniform_alignment;
 
-    ShaderManager();
+    explicit ShaderManager(StreamBuffer* stream);
     ~ShaderManager();
 
     Shader* load_program(const char* shader_name);
+    // Writes the uniforms of the frame, a single upload shared by every program, and binds
+    // them to FRAME_UNIFORMS_BINDING. It has to come after the mesh uploads of the frame.
+    void    update_frame_uniforms(const FrameUniforms& uniforms);
 };
 
 }
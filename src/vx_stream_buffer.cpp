@@ -0,0 +1,121 @@
+#include "vx_stream_buffer.hpp"
+#include <string.h>
+
+// Blocks until the GPU passed the fence, then deletes it.
+static void
+wait_stream_fence(GLsync& fence)
+{
+    if (fence == nullptr) return;
+
+    // One second at a time, the flush is only needed the first time.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true)
+    {
+        GLenum result = glClientWaitSync(fence, flags, 1000000000);
+        ASSERT(result != GL_WAIT_FAILED);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) break;
+        flags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+vx::StreamBuffer::StreamBuffer(u32 capacity)
+    : _capacity(capacity)
+    , _head(0)
+    , _segment(0)
+    , _mapped(nullptr)
+{
+    ASSERT(capacity > 0 && capacity % NUM_SEGMENTS == 0);
+    memset(_fences, 0, sizeof(_fences));
+
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+    if (GLEW_ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, capacity, nullptr, flags);
+        _mapped = (u8*)glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+        ASSERT(_mapped != NULL);
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+vx::StreamBuffer::~StreamBuffer()
+{
+    for (u32 i = 0; i < NUM_SEGMENTS; i++)
+        if (_fences[i] != nullptr) glDeleteSync(_fences[i]);
+    if (_mapped != nullptr)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &this->buffer);
+}
+
+void
+vx::StreamBuffer::enter_segment(u32 segment)
+{
+    // The draws that read the segment being left were all issued before this write.
+    ASSERT(_fences[_segment] == nullptr);
+    _fences[_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    wait_stream_fence(_fences[segment]);
+    _segment = segment;
+}
+
+u32
+vx::StreamBuffer::write(const void* data, u32 size, u32 alignment)
+{
+    const u32 segment_size = _capacity / NUM_SEGMENTS;
+    ASSERT(size > 0 && alignment > 0);
+    ASSERT(size + alignment - 1 <= segment_size);
+
+    // A write never spans two segments, so the fence placed when the writes leave a segment
+    // comes after every draw that reads it.
+    u32 offset = (_head + alignment - 1) / alignment * alignment;
+    if (offset + size > (_segment + 1) * segment_size)
+    {
+        const u32 segment = (_segment + 1) % NUM_SEGMENTS;
+        enter_segment(segment);
+        offset = (segment * segment_size + alignment - 1) / alignment * alignment;
+    }
+
+    if (_mapped != nullptr)
+    {
+        memcpy(_mapped + offset, data, size);
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        ASSERT(dst != NULL);
+        memcpy(dst, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    _head = offset + size;
+    return offset;
+}
+
+void
+vx::StreamBuffer::copy(GLuint dst, u32 offset, const void* data, u32 size)
+{
+    // Half a segment at a time, so a piece always fits with the padding of its alignment.
+    const u32 max_piece = _capacity / NUM_SEGMENTS / 2;
+    for (u32 done = 0; done < size; done += max_piece)
+    {
+        const u32 piece = MIN(size - done, max_piece);
+        const u32 src = write((const u8*)data + done, piece, 16);
+        glBindBuffer(GL_COPY_READ_BUFFER, this->buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, src, offset + done, piece);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef VX_STREAM_BUFFER_HPP
+#define VX_STREAM_BUFFER_HPP
+
+#include <GL/glew.h>
+#include "um.hpp"
+
+namespace vx
+{
+
+// Ring buffer for the small data that is written again every frame: the frame uniforms, text
+// and debug geometry, and in place updates of buffers the GPU may still be reading, see copy.
+// Every write goes after the last one and the draws read it at its offset, so the driver
+// never allocates or waits for the GPU to use a buffer that is being replaced.
+//
+// The buffer is split in segments, and a fence is placed after the draws of a segment when the
+// writes move on to the next one. A segment is only written again after its fence, a lap later.
+// With ARB_buffer_storage the buffer is mapped once, persistently. Without it, which is the case
+// of a plain GL 3.3 context, every write maps its range unsynchronized, since the fences already
+// keep it away from the draws in flight. The buffer is never orphaned, so ranges bound to it,
+// like the frame uniforms, keep their contents.
+struct StreamBuffer
+{
+    static constexpr u32 NUM_SEGMENTS = 4;
+
+    // Vertex arrays can point their attributes at it, the buffer is never replaced.
+    GLuint               buffer;
+
+    // Capacity in bytes. A write, with the padding of its alignment, fits in a segment.
+    explicit StreamBuffer(u32 capacity);
+    ~StreamBuffer();
+
+    // Copies size bytes into the buffer and returns their offset, a multiple of alignment. With
+    // the stride of the vertices as the alignment, offset / stride is the first vertex to draw.
+    // The data stays valid for the draws issued until the writes come back to its segment, a
+    // whole lap later. Data that is read for the whole frame, like the frame uniforms, has to be
+    // written after the bulk writes of the frame, e.g. the mesh updates.
+    u32 write(const void* data, u32 size, u32 alignment);
+    // Updates size bytes of another buffer at offset, written here and copied over by the GPU.
+    // The copy is ordered with the draws, so the draws in flight still read the old contents
+    // and the driver never has to wait for them or copy the buffer aside. Any size works, the
+    // data is split in pieces that fit a segment.
+    void copy(GLuint dst, u32 offset, const void* data, u32 size);
+
+private:
+    u32                  _capacity;
+    u32                  _head;
+    // Segment that the last write ended in.
+    u32                  _segment;
+    // Only set when the buffer is persistently mapped.
+    u8*                  _mapped;
+    // Fence after the last draws that read each segment, if it was not waited on yet.
+    GLsync               _fences[NUM_SEGMENTS];
+
+    // Fences the segment being written and waits until the GPU is done with the next segment.
+    void enter_segment(u32 segment);
+};
+
+}
+
+#endif // VX_STREAM_BUFFER_HPP
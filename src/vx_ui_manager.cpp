@@ -7,25 +7,27 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "vx_display.hpp"
 #include "vx_shader_manager.hpp"
+#include "vx_stream_buffer.hpp"
 
 #define MAX_LETTERS   50
 #define VERTICES_LEN (MAX_LETTERS * 6)
 
 static glm::vec4 vertices[VERTICES_LEN];
 
-vx::UIManager::UIManager(const char* fontname, vx::Shader* shader, vx::Display* display)
+vx::UIManager::UIManager(const char* fontname, vx::Shader* shader, vx::Display* display,
+                         vx::StreamBuffer* stream)
     : shader(shader)
+    , stream(stream)
     , fntfile(new FntFile(fontname))
 {
     glGenVertexArrays(1, &this->vao);
-    glGenBuffers(1, &this->fntfile_vbo);
 
     glBindVertexArray(this->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, this->fntfile_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, this->stream->buffer);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
     glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Setup projection matrix on the shader
     glm::mat4 projection = glm::ortho(0.0f, (f32)display->width, 0.0f, (f32)display->height, -1.0f, 1.0f);
@@ -37,7 +39,6 @@ vx::UIManager::UIManager(const char* fontname, vx::Shader* shader, vx::Display*
 
 vx::UIManager::~UIManager()
 {
-    glDeleteBuffers(1, &this->fntfile_vbo);
     glDeleteVertexArrays(1, &this->vao);
     delete this->fntfile;
 }
@@ -95,16 +96,14 @@ vx::UIManager::render_text(const char* str, glm::vec2 start, f32 scale)
 
         cursor.x += chr->xadvance;
     }
+    if (v == 0) return;
+
     // NOTE(leo): This is currently not necessary, but I will leave it here since it does
     // not hurt. If it really *does* hurt performance, it can be removed.
     /* glDisable(GL_DEPTH_TEST); */
 
+    const u32 offset = this->stream->write(vertices, sizeof(glm::vec4) * v, sizeof(glm::vec4));
     glBindVertexArray(this->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, this->fntfile_vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * v, vertices, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
 
     glBindTexture(GL_TEXTURE_2D, this->fntfile->texture_id);
     glActiveTexture(GL_TEXTURE0);
@@ -120,7 +119,7 @@ vx::UIManager::render_text(const char* str, glm::vec2 start, f32 scale)
     // Mainly used for text rendering
 
     // Draw all of the triangles for the characters.
-    glDrawArrays(GL_TRIANGLES, 0, 6 * textLen);
+    glDrawArrays(GL_TRIANGLES, offset / sizeof(glm::vec4), 6 * textLen);
     glBindVertexArray(0);
 
     // Reenable depth testing.
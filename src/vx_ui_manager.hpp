@@ -11,15 +11,17 @@ namespace vx
 struct Shader;
 struct FntFile;
 struct Display;
+struct StreamBuffer;
 
 struct UIManager
 {
     Shader*   shader;
+    // Reads the vertices of the text from the stream buffer.
     GLuint    vao;
-    GLuint    fntfile_vbo;
+    StreamBuffer* stream;
     FntFile*  fntfile;
 
-    UIManager(const char *fontname, Shader* shader, Display* display);
+    UIManager(const char *fontname, Shader* shader, Display* display, StreamBuffer* stream);
     ~UIManager();
 
     void render_text(const char* str, glm::vec2 startPosition, f32 scale);
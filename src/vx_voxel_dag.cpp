@@ -0,0 +1,320 @@
+#include "vx_voxel_dag.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr u32 EMPTY_SLOT = 0xFFFFFFFF;
+static constexpr u32 MAX_SIZE_LOG2 = 20;
+
+u64
+mix_bits(u64 bits)
+{
+    // splitmix64 finalizer, same as the chunk map.
+    bits ^= bits >> 30;
+    bits *= 0xbf58476d1ce4e5b9ull;
+    bits ^= bits >> 27;
+    bits *= 0x94d049bb133111ebull;
+    bits ^= bits >> 31;
+    return bits;
+}
+
+u64
+hash_node(const vx::VoxelDag::Node& node)
+{
+    u64 hash = 0;
+    for (u32 i = 0; i < 8; i += 2)
+        hash = mix_bits(hash ^ (((u64)node.children[i] << 32) | node.children[i+1]));
+    return hash;
+}
+
+// Grows an open addressing table of indices, rehashing every entry with hash_entry.
+template<typename HashEntry>
+void
+grow_table(u32*& table, u32& capacity, HashEntry hash_entry)
+{
+    u32* old_table = table;
+    u32 old_capacity = capacity;
+
+    capacity = (capacity == 0) ? 1024 : capacity * 2;
+    table = (u32*)malloc(sizeof(u32) * capacity);
+    ASSERT(table != NULL);
+    memset(table, 0xFF, sizeof(u32) * capacity);
+
+    const u32 mask = capacity - 1;
+    for (u32 i = 0; i < old_capacity; i++)
+    {
+        if (old_table[i] == EMPTY_SLOT) continue;
+
+        u32 j = hash_entry(old_table[i]) & mask;
+        while (table[j] != EMPTY_SLOT)
+            j = (j + 1) & mask;
+        table[j] = old_table[i];
+    }
+    free(old_table);
+}
+
+vx::VoxelDag::VoxelDag()
+    : nodes(nullptr)
+    , num_nodes(0)
+    , nodes_capacity(0)
+    , leaves(nullptr)
+    , num_leaves(0)
+    , leaves_capacity(0)
+    , root(REF_EMPTY)
+    , min_chunk(0, 0, 0)
+    , size_log2(0)
+    , _node_table(nullptr)
+    , _node_table_capacity(0)
+    , _leaf_table(nullptr)
+    , _leaf_table_capacity(0)
+{
+}
+
+vx::VoxelDag::~VoxelDag()
+{
+    free(this->nodes);
+    free(this->leaves);
+}
+
+void
+vx::VoxelDag::build(vx::ChunkCoord min_chunk, u32 size_log2, vx::DagChunkSource source, void* user_data)
+{
+    ASSERT(size_log2 <= MAX_SIZE_LOG2);
+    this->min_chunk = min_chunk;
+    this->size_log2 = size_log2;
+    this->num_nodes = 0;
+    this->num_leaves = 0;
+
+    this->root = build_node(min_chunk, size_log2, source, user_data);
+
+    // The world does not change after it is built, so the arrays are trimmed and the
+    // deduplication tables are not needed anymore.
+    free(this->_node_table);
+    free(this->_leaf_table);
+    this->_node_table = nullptr;
+    this->_leaf_table = nullptr;
+    this->_node_table_capacity = 0;
+    this->_leaf_table_capacity = 0;
+
+    if (this->num_nodes > 0)
+        this->nodes = (Node*)realloc(this->nodes, sizeof(Node) * this->num_nodes);
+    if (this->num_leaves > 0)
+        this->leaves = (u64*)realloc(this->leaves, sizeof(u64) * this->num_leaves);
+    this->nodes_capacity = this->num_nodes;
+    this->leaves_capacity = this->num_leaves;
+}
+
+u32
+vx::VoxelDag::build_node(vx::ChunkCoord min_chunk, u32 size_log2, vx::DagChunkSource source, void* user_data)
+{
+    if (size_log2 == 0)
+    {
+        u32 columns[32][32];
+        if (!source(min_chunk, columns, user_data))
+            return REF_EMPTY;
+        return build_chunk_node(columns, 0, 0, 0, 32);
+    }
+
+    const i32 half = 1 << (size_log2 - 1);
+    Node node;
+    for (u32 c = 0; c < 8; c++)
+    {
+        vx::ChunkCoord child_min(min_chunk.x + ((c >> 2) & 1) * half,
+                                 min_chunk.y + ((c >> 1) & 1) * half,
+                                 min_chunk.z + (c & 1) * half);
+        node.children[c] = build_node(child_min, size_log2 - 1, source, user_data);
+    }
+    return add_node(node);
+}
+
+u32
+vx::VoxelDag::build_chunk_node(const u32 columns[32][32], u32 x, u32 y, u32 z, u32 size)
+{
+    if (size == 4)
+    {
+        // Same bit order as a brick of BrickLayout: [x][z][y], a nibble per column.
+        u64 leaf = 0;
+        for (u32 lx = 0; lx < 4; lx++)
+            for (u32 lz = 0; lz < 4; lz++)
+                leaf |= (u64)((columns[x + lx][z + lz] >> y) & 0xF) << ((lx * 4 + lz) * 4);
+        return add_leaf(leaf);
+    }
+
+    const u32 half = size / 2;
+    Node node;
+    for (u32 c = 0; c < 8; c++)
+        node.children[c] = build_chunk_node(columns,
+                                            x + ((c >> 2) & 1) * half,
+                                            y + ((c >> 1) & 1) * half,
+                                            z + (c & 1) * half, half);
+    return add_node(node);
+}
+
+u32
+vx::VoxelDag::add_node(const Node& node)
+{
+    // Uniform subtrees collapse into a single reference, whatever their size.
+    bool all_empty = true;
+    bool all_full = true;
+    for (u32 c = 0; c < 8; c++)
+    {
+        all_empty &= node.children[c] == REF_EMPTY;
+        all_full &= node.children[c] == REF_FULL;
+    }
+    if (all_empty) return REF_EMPTY;
+    if (all_full) return REF_FULL;
+
+    // Keep the load factor under 1/2.
+    if ((this->num_nodes + 1) * 2 > this->_node_table_capacity)
+    {
+        const Node* nodes = this->nodes;
+        grow_table(this->_node_table, this->_node_table_capacity,
+                   [nodes](u32 index) { return hash_node(nodes[index]); });
+    }
+
+    const u32 mask = this->_node_table_capacity - 1;
+    u32 i = hash_node(node) & mask;
+    for (; this->_node_table[i] != EMPTY_SLOT; i = (i + 1) & mask)
+    {
+        const u32 index = this->_node_table[i];
+        if (memcmp(&this->nodes[index], &node, sizeof(Node)) == 0)
+            return index + REF_FIRST;
+    }
+
+    if (this->num_nodes == this->nodes_capacity)
+    {
+        this->nodes_capacity = MAX(64, this->nodes_capacity * 2);
+        this->nodes = (Node*)realloc(this->nodes, sizeof(Node) * this->nodes_capacity);
+        ASSERT(this->nodes != NULL);
+    }
+    const u32 index = this->num_nodes++;
+    this->nodes[index] = node;
+    this->_node_table[i] = index;
+    return index + REF_FIRST;
+}
+
+u32
+vx::VoxelDag::add_leaf(u64 leaf)
+{
+    if (leaf == 0) return REF_EMPTY;
+    if (leaf == ~0ull) return REF_FULL;
+
+    if ((this->num_leaves + 1) * 2 > this->_leaf_table_capacity)
+    {
+        const u64* leaves = this->leaves;
+        grow_table(this->_leaf_table, this->_leaf_table_capacity,
+                   [leaves](u32 index) { return mix_bits(leaves[index]); });
+    }
+
+    const u32 mask = this->_leaf_table_capacity - 1;
+    u32 i = mix_bits(leaf) & mask;
+    for (; this->_leaf_table[i] != EMPTY_SLOT; i = (i + 1) & mask)
+    {
+        const u32 index = this->_leaf_table[i];
+        if (this->leaves[index] == leaf)
+            return index + REF_FIRST;
+    }
+
+    if (this->num_leaves == this->leaves_capacity)
+    {
+        this->leaves_capacity = MAX(64, this->leaves_capacity * 2);
+        this->leaves = (u64*)realloc(this->leaves, sizeof(u64) * this->leaves_capacity);
+        ASSERT(this->leaves != NULL);
+    }
+    const u32 index = this->num_leaves++;
+    this->leaves[index] = leaf;
+    this->_leaf_table[i] = index;
+    return index + REF_FIRST;
+}
+
+bool
+vx::VoxelDag::block(i32 x, i32 y, i32 z) const
+{
+    // Position inside the region. Out of range coordinates wrap to big values.
+    const u32 world_size = 32u << this->size_log2;
+    const u32 lx = (u32)(x - this->min_chunk.x * 32);
+    const u32 ly = (u32)(y - this->min_chunk.y * 32);
+    const u32 lz = (u32)(z - this->min_chunk.z * 32);
+    if (lx >= world_size || ly >= world_size || lz >= world_size)
+        return false;
+
+    u32 ref = this->root;
+    u32 size = world_size;
+    while (true)
+    {
+        if (ref == REF_EMPTY) return false;
+        if (ref == REF_FULL) return true;
+        if (size == 4)
+        {
+            const u64 leaf = this->leaves[ref - REF_FIRST];
+            return (leaf >> (((lx % 4) * 4 + (lz % 4)) * 4 + (ly % 4))) & 1;
+        }
+
+        size /= 2;
+        const u32 c = ((lx & size) ? 4 : 0) | ((ly & size) ? 2 : 0) | ((lz & size) ? 1 : 0);
+        ref = this->nodes[ref - REF_FIRST].children[c];
+    }
+}
+
+void
+fill_columns(const vx::VoxelDag& dag, u32 ref, u32 size, u32 x, u32 y, u32 z, u32 out[32][32])
+{
+    if (ref == vx::VoxelDag::REF_EMPTY)
+        return;
+
+    if (ref == vx::VoxelDag::REF_FULL)
+    {
+        const u32 mask = (size == 32) ? ~0u : (((1u << size) - 1) << y);
+        for (u32 i = 0; i < size; i++)
+            for (u32 k = 0; k < size; k++)
+                out[x + i][z + k] |= mask;
+        return;
+    }
+
+    if (size == 4)
+    {
+        const u64 leaf = dag.leaves[ref - vx::VoxelDag::REF_FIRST];
+        for (u32 lx = 0; lx < 4; lx++)
+            for (u32 lz = 0; lz < 4; lz++)
+                out[x + lx][z + lz] |= (u32)((leaf >> ((lx * 4 + lz) * 4)) & 0xF) << y;
+        return;
+    }
+
+    const u32 half = size / 2;
+    const vx::VoxelDag::Node& node = dag.nodes[ref - vx::VoxelDag::REF_FIRST];
+    for (u32 c = 0; c < 8; c++)
+        fill_columns(dag, node.children[c], half,
+                     x + ((c >> 2) & 1) * half, y + ((c >> 1) & 1) * half, z + (c & 1) * half, out);
+}
+
+bool
+vx::VoxelDag::get_chunk_columns(vx::ChunkCoord coord, u32 out[32][32]) const
+{
+    memset(out, 0, sizeof(u32) * 32 * 32);
+
+    const u32 world_chunks = 1u << this->size_log2;
+    const u32 cx = (u32)(coord.x - this->min_chunk.x);
+    const u32 cy = (u32)(coord.y - this->min_chunk.y);
+    const u32 cz = (u32)(coord.z - this->min_chunk.z);
+    if (cx >= world_chunks || cy >= world_chunks || cz >= world_chunks)
+        return false;
+
+    // Go down to the node of the chunk, the same walk as block but in chunk units.
+    u32 ref = this->root;
+    u32 size = world_chunks;
+    while (size > 1 && ref != REF_EMPTY && ref != REF_FULL)
+    {
+        size /= 2;
+        const u32 c = ((cx & size) ? 4 : 0) | ((cy & size) ? 2 : 0) | ((cz & size) ? 1 : 0);
+        ref = this->nodes[ref - REF_FIRST].children[c];
+    }
+
+    if (ref == REF_EMPTY) return false;
+    fill_columns(*this, ref, 32, 0, 0, 0, out);
+    return true;
+}
+
+u32
+vx::VoxelDag::memory_usage() const
+{
+    return sizeof(*this) + this->nodes_capacity * sizeof(Node) + this->leaves_capacity * sizeof(u64);
+}
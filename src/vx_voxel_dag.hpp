@@ -0,0 +1,75 @@
+#ifndef VX_VOXEL_DAG_HPP
+#define VX_VOXEL_DAG_HPP
+
+#include "um.hpp"
+#include "vx_chunk_map.hpp"
+
+namespace vx
+{
+
+// Provides the occupancy of a chunk while a VoxelDag is built, as 32x32 columns indexed
+// [x][z] with bit y set if the block exists. Returns false if the chunk has no blocks, in
+// which case the columns are ignored.
+typedef bool (*DagChunkSource)(ChunkCoord coord, u32 columns[32][32], void* user_data);
+
+// Read only world storage for big static maps. The world is a sparse voxel octree where equal
+// subtrees are stored only once, i.e. a directed acyclic graph. Solid and empty subtrees of
+// any size are not stored at all, so large volumes of rock or sky cost a single reference.
+//
+// The tree stops at 4x4x4 leaves, stored as one u64 each with the same bit order as the
+// bricks of BrickLayout. Only occupancy is kept, not block types.
+//
+// Lookups use world block coordinates, like ChunkManager::block, and whole chunks can be
+// extracted as columns to be meshed like any other chunk.
+struct VoxelDag
+{
+    // Child references. Anything else is an index into nodes or leaves, plus REF_FIRST.
+    static constexpr u32 REF_EMPTY = 0;
+    static constexpr u32 REF_FULL = 1;
+    static constexpr u32 REF_FIRST = 2;
+
+    struct Node
+    {
+        u32 children[8];
+    };
+
+    Node*      nodes;
+    u32        num_nodes;
+    u32        nodes_capacity;
+    u64*       leaves;
+    u32        num_leaves;
+    u32        leaves_capacity;
+    u32        root;
+    // Covered region, in chunks: 2^size_log2 chunks along each axis starting at min_chunk.
+    ChunkCoord min_chunk;
+    u32        size_log2;
+
+    VoxelDag();
+    ~VoxelDag();
+
+    // Replaces the contents of the dag with the chunks of the region, read from source.
+    void build(ChunkCoord min_chunk, u32 size_log2, DagChunkSource source, void* user_data);
+
+    // Blocks outside of the region are empty.
+    bool block(i32 x, i32 y, i32 z) const;
+    // Returns false if the chunk is empty, out is filled either way.
+    bool get_chunk_columns(ChunkCoord coord, u32 out[32][32]) const;
+
+    u32  memory_usage() const;
+
+private:
+    // Deduplication tables, indices into nodes and leaves. Only used while building.
+    u32*       _node_table;
+    u32        _node_table_capacity;
+    u32*       _leaf_table;
+    u32        _leaf_table_capacity;
+
+    u32  build_node(ChunkCoord min_chunk, u32 size_log2, DagChunkSource source, void* user_data);
+    u32  build_chunk_node(const u32 columns[32][32], u32 x, u32 y, u32 z, u32 size);
+    u32  add_node(const Node& node);
+    u32  add_leaf(u64 leaf);
+};
+
+}
+
+#endif // VX_VOXEL_DAG_HPP
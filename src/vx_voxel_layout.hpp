@@ -0,0 +1,186 @@
+#ifndef VX_VOXEL_LAYOUT_HPP
+#define VX_VOXEL_LAYOUT_HPP
+
+#include "um.hpp"
+
+// Orders in which the 32x32x32 occupancy bits of a chunk can be stored. Each layout maps a
+// block to a bit index in [0, 32768), the same index is used for the chunk's BlockPalette.
+//
+// The meshers and occluders read whole y columns (bit y set if the block exists), so every
+// layout also knows how to get a column out of its words and how to build the words back
+// from columns. The layout used by the chunks is picked at compile time by defining
+// VX_CHUNK_LAYOUT (e.g. -DVX_CHUNK_LAYOUT=MortonLayout), `make bench` compares them.
+
+namespace vx
+{
+
+static constexpr u32 VOXEL_LAYOUT_SIZE = 32;
+static constexpr u32 VOXEL_LAYOUT_WORDS = VOXEL_LAYOUT_SIZE * VOXEL_LAYOUT_SIZE * VOXEL_LAYOUT_SIZE / 64;
+
+// Blocks ordered as [x][z][y], i.e. a column is a single u32 and two columns share a word.
+// Extracting columns is a copy, but neighbours along x are 1 KB apart.
+struct LinearLayout
+{
+    static constexpr const char* NAME = "linear";
+
+    static inline u32 index(u32 x, u32 y, u32 z)
+    {
+        return (x * 32 + z) * 32 + y;
+    }
+
+    static inline u32 column(const u64* words, u32 x, u32 z)
+    {
+        const u32 c = x * 32 + z;
+        return (u32)(words[c / 2] >> ((c % 2) * 32));
+    }
+
+    static inline void load_columns(const u64* words, u32 columns[32][32])
+    {
+        for (u32 x = 0; x < 32; x++)
+            for (u32 z = 0; z < 32; z += 2)
+            {
+                const u64 word = words[(x * 32 + z) / 2];
+                columns[x][z] = (u32)word;
+                columns[x][z+1] = (u32)(word >> 32);
+            }
+    }
+
+    static inline void store_columns(u64* words, const u32 columns[32][32])
+    {
+        for (u32 x = 0; x < 32; x++)
+            for (u32 z = 0; z < 32; z += 2)
+                words[(x * 32 + z) / 2] = (u64)columns[x][z] | ((u64)columns[x][z+1] << 32);
+    }
+};
+
+// Z-order curve, the bits of x, y and z are interleaved. Every word holds a 4x4x4 cube and
+// nearby blocks are nearby in memory along every axis, at the cost of gathering columns.
+struct MortonLayout
+{
+    static constexpr const char* NAME = "morton";
+
+    // Spreads the 5 bits of v three bits apart.
+    static inline u32 spread(u32 v)
+    {
+        v = (v | (v << 8)) & 0x0000F00F;
+        v = (v | (v << 4)) & 0x000C30C3;
+        v = (v | (v << 2)) & 0x00249249;
+        return v;
+    }
+
+    static inline u32 index(u32 x, u32 y, u32 z)
+    {
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    static inline u32 column(const u64* words, u32 x, u32 z)
+    {
+        // Inside a word, the four y values of a x/z pair sit at bits b, b+2, b+16 and b+18.
+        const u32 b = spread(x % 4) | (spread(z % 4) << 2);
+        const u32 base = spread(x / 4) | (spread(z / 4) << 2);
+        u32 result = 0;
+        for (u32 by = 0; by < 8; by++)
+        {
+            const u64 word = words[base | (spread(by) << 1)] >> b;
+            const u32 nibble = (u32)((word & 1) | ((word >> 1) & 2) | ((word >> 14) & 4) | ((word >> 15) & 8));
+            result |= nibble << (by * 4);
+        }
+        return result;
+    }
+
+    static inline void load_columns(const u64* words, u32 columns[32][32])
+    {
+        for (u32 x = 0; x < 32; x++)
+            for (u32 z = 0; z < 32; z++)
+                columns[x][z] = column(words, x, z);
+    }
+
+    static inline void store_columns(u64* words, const u32 columns[32][32])
+    {
+        for (u32 i = 0; i < VOXEL_LAYOUT_WORDS; i++)
+            words[i] = 0;
+        for (u32 x = 0; x < 32; x++)
+            for (u32 z = 0; z < 32; z++)
+                for (u32 bits = columns[x][z]; bits != 0; bits &= bits - 1)
+                {
+                    const u32 i = index(x, um::count_trailing_zeros(bits), z);
+                    words[i / 64] |= 1ull << (i % 64);
+                }
+    }
+};
+
+// 4x4x4 bricks, one word each, stored as [x][z][y] bricks. Inside a brick the blocks are
+// ordered as [x][z][y] too, so the part of a column that is in a brick is a nibble.
+struct BrickLayout
+{
+    static constexpr const char* NAME = "brick";
+
+    static inline u32 index(u32 x, u32 y, u32 z)
+    {
+        const u32 brick = ((x / 4) * 8 + (z / 4)) * 8 + (y / 4);
+        return brick * 64 + ((x % 4) * 4 + (z % 4)) * 4 + (y % 4);
+    }
+
+    static inline u32 column(const u64* words, u32 x, u32 z)
+    {
+        const u64* bricks = words + ((x / 4) * 8 + (z / 4)) * 8;
+        const u32 shift = ((x % 4) * 4 + (z % 4)) * 4;
+        u32 result = 0;
+        for (u32 by = 0; by < 8; by++)
+            result |= (u32)((bricks[by] >> shift) & 0xF) << (by * 4);
+        return result;
+    }
+
+    static inline void load_columns(const u64* words, u32 columns[32][32])
+    {
+        for (u32 x = 0; x < 32; x++)
+            for (u32 z = 0; z < 32; z++)
+                columns[x][z] = column(words, x, z);
+    }
+
+    static inline void store_columns(u64* words, const u32 columns[32][32])
+    {
+        for (u32 bx = 0; bx < 8; bx++)
+            for (u32 bz = 0; bz < 8; bz++)
+                for (u32 by = 0; by < 8; by++)
+                {
+                    u64 brick = 0;
+                    for (u32 lx = 0; lx < 4; lx++)
+                        for (u32 lz = 0; lz < 4; lz++)
+                        {
+                            const u64 nibble = (columns[bx*4 + lx][bz*4 + lz] >> (by * 4)) & 0xF;
+                            brick |= nibble << ((lx * 4 + lz) * 4);
+                        }
+                    words[(bx * 8 + bz) * 8 + by] = brick;
+                }
+    }
+};
+
+template<typename Layout>
+inline bool
+voxel_get(const u64* words, u32 x, u32 y, u32 z)
+{
+    const u32 i = Layout::index(x, y, z);
+    return (words[i / 64] >> (i % 64)) & 1;
+}
+
+template<typename Layout>
+inline void
+voxel_set(u64* words, u32 x, u32 y, u32 z, bool exists)
+{
+    const u32 i = Layout::index(x, y, z);
+    if (exists)
+        words[i / 64] |= 1ull << (i % 64);
+    else
+        words[i / 64] &= ~(1ull << (i % 64));
+}
+
+#ifndef VX_CHUNK_LAYOUT
+#define VX_CHUNK_LAYOUT LinearLayout
+#endif
+
+typedef VX_CHUNK_LAYOUT ChunkLayout;
+
+}
+
+#endif // VX_VOXEL_LAYOUT_HPP